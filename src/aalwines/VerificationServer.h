@@ -0,0 +1,196 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   VerificationServer.h
+ *
+ * Keeps a parsed network in memory and answers queries sent as newline-delimited JSON.
+ * Each request is an object like {"id": 1, "query": "<.> [.#R0] .* [R1#.] <.> 0 OVER", "weight": [...]},
+ * where "id" (echoed back) and "weight" (same format as --weight) are optional.
+ * Each answer is a single line with the same object as the "answers" entries of the command line tool,
+ * or {"id": 1, "error": "..."} if the request could not be handled.
+ */
+
+#ifndef AALWINES_VERIFICATIONSERVER_H
+#define AALWINES_VERIFICATIONSERVER_H
+
+#include <aalwines/Verifier.h>
+#include <aalwines/model/NetworkWeight.h>
+#include <aalwines/query/parsererrors.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace aalwines {
+
+    class VerificationServer {
+    public:
+        VerificationServer(Network& network, Verifier& verifier, bool print_timing = true)
+        : _builder(network), _verifier(verifier), _print_timing(print_timing) {};
+
+        // Answer requests from in until it is closed.
+        void serve(std::istream& in, std::ostream& out) {
+            std::string line;
+            while (std::getline(in, line)) {
+                if (is_blank(line)) continue;
+                out << handle(line).dump() << std::endl;
+            }
+        }
+
+        // Listen on a Unix domain socket and answer requests on each connection until the client closes it.
+        // Connections are served one at a time.
+        void serve_socket(const std::string& path) {
+            sockaddr_un address{};
+            if (path.size() >= sizeof(address.sun_path)) {
+                throw base_error("Socket path is too long: " + path);
+            }
+            // Replace a socket left by an earlier server, but never delete anything else at the path.
+            struct stat status{};
+            if (lstat(path.c_str(), &status) == 0) {
+                if (!S_ISSOCK(status.st_mode)) {
+                    throw base_error("Will not replace " + path + ", which is not a socket.");
+                }
+                unlink(path.c_str());
+            }
+            int server = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (server < 0) {
+                throw base_error(std::string("Could not create socket: ") + std::strerror(errno));
+            }
+            address.sun_family = AF_UNIX;
+            std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+            if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(server, 8) < 0) {
+                auto error = std::string("Could not listen on socket ") + path + ": " + std::strerror(errno);
+                close(server);
+                throw base_error(error);
+            }
+            while (true) {
+                int client = accept(server, nullptr, nullptr);
+                if (client < 0) {
+                    if (errno == EINTR) continue;
+                    auto error = std::string("Could not accept connection: ") + std::strerror(errno);
+                    close(server);
+                    throw base_error(error);
+                }
+                serve_connection(client);
+                close(client);
+            }
+        }
+
+        json handle(const std::string& request_line) {
+            json request;
+            try {
+                request = json::parse(request_line);
+            } catch (const nlohmann::detail::parse_error& error) {
+                return error_response(json(), std::string("Invalid JSON: ") + error.what());
+            }
+            json id = request.is_object() && request.contains("id") ? request["id"] : json();
+            if (!request.is_object() || !request.contains("query") || !request["query"].is_string()) {
+                return error_response(id, "Request must be an object with a \"query\" string.");
+            }
+            auto query_string = request["query"].get<std::string>();
+            try {
+                _builder.reset();
+                std::istringstream qstream(query_string);
+                _builder.do_parse(qstream);
+                if (_builder._result.size() != 1) {
+                    return error_response(id, "Request must contain exactly one query.");
+                }
+                json answer;
+                if (request.contains("weight") && !request["weight"].is_null()) {
+                    if (!_verifier.supports_weight()) {
+                        return error_response(id, "Shortest trace using weights is only implemented for --engine 1 (post*).");
+                    }
+                    std::istringstream wstream(request["weight"].dump());
+                    auto weight_fn = NetworkWeight().parse(wstream);
+                    answer = _verifier.run_once(_builder, _builder._result[0], _print_timing, weight_fn);
+                } else {
+                    answer = _verifier.run_once(_builder, _builder._result[0], _print_timing);
+                }
+                answer["query"] = query_string;
+                if (!id.is_null()) answer["id"] = id;
+                return answer;
+            } catch (const base_parser_error& error) {
+                std::stringstream message;
+                message << error;
+                return error_response(id, "Error during parsing: " + message.str());
+            } catch (const base_error& error) {
+                return error_response(id, error.what());
+            } catch (const nlohmann::json::exception& error) { // E.g. a field of the weight with the wrong type.
+                return error_response(id, std::string("Invalid request: ") + error.what());
+            } catch (const std::exception& error) {
+                return error_response(id, error.what());
+            }
+        }
+
+    private:
+        void serve_connection(int client) {
+            std::string buffer;
+            char chunk[4096];
+            while (true) {
+                auto n = read(client, chunk, sizeof(chunk));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                buffer.append(chunk, n);
+                size_t start = 0, end;
+                while ((end = buffer.find('\n', start)) != std::string::npos) {
+                    auto line = buffer.substr(start, end - start);
+                    start = end + 1;
+                    if (is_blank(line)) continue;
+                    if (!write_all(client, handle(line).dump() + "\n")) return;
+                }
+                buffer.erase(0, start);
+            }
+            if (!is_blank(buffer)) { // Last request without a trailing newline.
+                write_all(client, handle(buffer).dump() + "\n");
+            }
+        }
+
+        static bool write_all(int fd, const std::string& data) {
+            size_t written = 0;
+            while (written < data.size()) {
+                auto n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL); // Do not die on SIGPIPE if the client is gone.
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                written += n;
+            }
+            return true;
+        }
+
+        static bool is_blank(const std::string& line) {
+            return line.find_first_not_of(" \t\r") == std::string::npos;
+        }
+
+        static json error_response(const json& id, const std::string& message) {
+            json response;
+            if (!id.is_null()) response["id"] = id;
+            response["error"] = message;
+            return response;
+        }
+
+        Builder _builder;
+        Verifier& _verifier;
+        bool _print_timing;
+    };
+
+}
+
+#endif //AALWINES_VERIFICATIONSERVER_H
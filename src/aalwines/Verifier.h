@@ -30,13 +30,27 @@
 #include <aalwines/utils/json_stream.h>
 #include <aalwines/utils/stopwatch.h>
 #include <aalwines/utils/outcome.h>
+#include <aalwines/utils/budget.h>
+#include <aalwines/utils/result_cache.h>
+#include <aalwines/utils/system.h>
 #include <aalwines/query/QueryBuilder.h>
 #include <aalwines/model/NetworkPDAFactory.h>
 #include <aalwines/model/NetworkWeight.h>
+#include <aalwines/model/NetworkDelta.h>
+#include <aalwines/model/builders/AalWiNesBuilder.h>
 #include <pdaaal/SolverAdapter.h>
 #include <pdaaal/Reducer.h>
 
 #include <boost/program_options.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <exception>
+#include <set>
+#include <unordered_set>
 namespace po = boost::program_options;
 
 namespace aalwines {
@@ -56,6 +70,14 @@ namespace aalwines {
                     ("engine,e", po::value<size_t>(&_engine), "0=no verification,1=post*,2=pre*")
                     ("tos-reduction,r", po::value<size_t>(&_reduction), "0=none,1=simple,2=dual-stack,3=simple+backup,4=dual-stack+backup")
                     ("trace,t", po::bool_switch(&_print_trace), "Get a trace when possible")
+                    ("threads", po::value<size_t>(&_threads), "Number of queries to verify in parallel. Answers are still reported in query order.")
+                    ("speculative-dual", po::bool_switch(&_speculative_dual), "Run the OVER- and UNDER-approximation of DUAL queries concurrently, and stop the other as soon as one is conclusive.")
+                    ("timeout", po::value<double>(&_timeout), "Time limit in seconds for each query. A query exceeding it gives the result TIMEOUT. 0=no limit")
+                    ("memory-limit", po::value<size_t>(&_memory_limit), "Memory limit in MB for the whole process, checked while verifying a query. A query exceeding it gives the result MEMOUT. The limit is process-wide, so with --threads or --speculative-dual the memory of the queries or approximations running at the same time counts against each of them. 0=no limit")
+                    ("cache-dir", po::value<std::string>(&_cache_dir), "Store answers in this directory, and reuse them for the same query on an identical network with the same settings.")
+                    ("footprint", po::bool_switch(&_print_footprint), "Include in each answer the interfaces whose routing tables the answer depends on.")
+                    ("stats", po::bool_switch(&_print_stats), "Include statistics of the PDA construction and verification of each mode in the answers.")
+                    ("no-pruning", po::bool_switch(&_no_pruning), "Do not prune the PDA to the states that can reach the end of the path. Gives the same answers, only slower; meant for testing.")
                     ;
         }
 
@@ -71,147 +93,569 @@ namespace aalwines {
                 std::cerr << "Unknown value for --engine : " << _engine << std::endl;
                 exit(-1);
             }
+            if(_threads == 0) {
+                std::cerr << "--threads must be at least 1" << std::endl;
+                exit(-1);
+            }
+            if(_timeout < 0) {
+                std::cerr << "--timeout must not be negative" << std::endl;
+                exit(-1);
+            }
+            if(_memory_limit > 0 && (_threads > 1 || _speculative_dual)) {
+                std::cerr << "Warning: --memory-limit applies to the whole process. With --threads or --speculative-dual a query may give MEMOUT because of memory used by the other runs at the same time." << std::endl;
+            }
         }
+        [[nodiscard]] bool supports_weight() const { return _engine == 1; }
         void check_supports_weight() const {
-            if (_engine != 1) {
+            if (!supports_weight()) {
                 std::cerr << "Shortest trace using weights is only implemented for --engine 1 (post*). Not for --engine " << _engine << std::endl;
                 exit(-1);
             }
         }
         void set_print_trace() { _print_trace = true; }
+        void set_speculative_dual() { _speculative_dual = true; }
+        void set_threads(size_t threads) { _threads = threads; }
+        void set_timeout(double timeout) { _timeout = timeout; }
+        void set_memory_limit(size_t memory_limit) { _memory_limit = memory_limit; }
+        void set_cache_dir(const std::string& cache_dir) { _cache_dir = cache_dir; }
+        // Identifies the weight function in cache keys. Weighted runs are only cached when this is set.
+        void set_cache_weight(const std::string& weight) { _cache_weight = weight; }
+        void set_print_footprint() { _print_footprint = true; }
+        void set_print_stats() { _print_stats = true; }
+        void set_pruning(bool prune) { _no_pruning = !prune; }
+
+        // Reuse answers (with footprints) from an earlier run, on the network before the delta was applied,
+        // for the queries whose footprint is not affected by the delta, if the earlier run used the same settings.
+        // The delta must outlive the Verifier.
+        void set_previous_answers(const json& answers, const NetworkDelta& delta) {
+            _previous_answers.clear();
+            for (const auto& [_, answer] : answers.items()) {
+                if (answer.contains("query") && answer.contains("footprint")) {
+                    _previous_answers[normalize_query(answer["query"].get<std::string>())] = answer;
+                }
+            }
+            _delta = &delta;
+            _print_footprint = true; // So the new answers can be reused in the same way.
+        }
 
+        // query_strings[i] must be the text of builder._result[i] (see Builder::query_texts), as it identifies
+        // the query in the answers, in the cache and among the previous answers.
         template<typename W_FN = std::function<void(void)>>
         void run(Builder& builder, const std::vector<std::string>& query_strings, json_stream& json_output, bool print_timing = true, const W_FN& weight_fn = [](){}) {
-            size_t query_no = 0;
-            for (auto& q : builder._result) {
+            constexpr static bool is_weighted = pdaaal::is_weighted<typename W_FN::result_type>;
+            if (query_strings.size() != builder._result.size()) {
+                throw base_error("The number of query strings (" + std::to_string(query_strings.size()) +
+                                 ") does not match the number of parsed queries (" + std::to_string(builder._result.size()) + ").");
+            }
+            std::optional<utils::result_cache> cache;
+            json cache_key;
+            if (!_cache_dir.empty() && (!is_weighted || !_cache_weight.empty())) {
+                cache.emplace(_cache_dir);
+                cache_key = cache_key_base(builder._network);
+            }
+            auto answer = [&, this](size_t query_no) {
+                return answer_query(builder, builder._result[query_no], query_strings[query_no], print_timing, weight_fn, cache ? &cache.value() : nullptr, cache_key);
+            };
+
+            if (_threads > 1 && builder._result.size() > 1) {
+                run_parallel(builder, query_strings, json_output, answer);
+                return;
+            }
+            for (size_t query_no = 0; query_no < builder._result.size(); ++query_no) {
                 std::stringstream qn;
                 qn << "Q" << query_no+1;
 
-                auto res = run_once(builder, q, print_timing, weight_fn);
+                auto res = answer(query_no);
                 res["query"] = query_strings[query_no];
                 json_output.entry_object(qn.str(), res);
+            }
+        }
 
-                ++query_no;
+    private:
+        // Runs the queries on a pool of _threads workers. Each run_once builds its own factory and solver,
+        // so the only shared state is the (read-only) network, and the answers are emitted here in query order.
+        template<typename ANSWER_FN>
+        void run_parallel(Builder& builder, const std::vector<std::string>& query_strings, json_stream& json_output, const ANSWER_FN& answer) {
+            const size_t num_queries = builder._result.size();
+            std::vector<json> results(num_queries);
+            std::vector<std::exception_ptr> errors(num_queries);
+            std::vector<bool> done(num_queries, false);
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::atomic<size_t> next_query{0};
+            std::atomic<bool> stop{false};
+
+            // Fill the caches before the workers start reading them.
+            builder.all_labels();
+            builder.transitions();
+
+            auto worker = [&]() {
+                for (size_t i = next_query++; i < num_queries && !stop; i = next_query++) {
+                    json res;
+                    std::exception_ptr error;
+                    try {
+                        res = answer(i);
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        results[i] = std::move(res);
+                        errors[i] = error;
+                        done[i] = true;
+                    }
+                    cv.notify_all();
+                }
+            };
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < std::min(_threads, num_queries); ++t) {
+                workers.emplace_back(worker);
+            }
+
+            std::exception_ptr error;
+            for (size_t query_no = 0; query_no < num_queries; ++query_no) {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&done, query_no](){ return done[query_no]; });
+                if (errors[query_no]) {
+                    error = errors[query_no];
+                    stop = true;
+                    break;
+                }
+                auto res = std::move(results[query_no]);
+                lock.unlock();
+
+                std::stringstream qn;
+                qn << "Q" << query_no+1;
+                res["query"] = query_strings[query_no];
+                json_output.entry_object(qn.str(), res);
+            }
+            for (auto& w : workers) {
+                w.join();
+            }
+            if (error) {
+                std::rethrow_exception(error);
             }
         }
 
+        // The settings an answer depends on, besides the network and the query.
+        // Written in answers with footprints, so only answers from a run with the same settings are reused.
+        json settings() const {
+            json s;
+            s["engine"] = _engine;
+            s["reduction"] = _reduction;
+            s["trace"] = _print_trace;
+            s["footprint"] = _print_footprint;
+            s["stats"] = _print_stats;
+            s["weight"] = _cache_weight.empty() ? std::string() : utils::result_cache::hash(_cache_weight);
+            return s;
+        }
+
+        // The part of the cache key shared by all queries in a run.
+        json cache_key_base(const Network& network) const {
+            json key = settings();
+            key["version"] = 1;
+            key["network"] = utils::result_cache::hash(json(network).dump());
+            return key;
+        }
+
+        static std::string normalize_query(const std::string& query_string) {
+            std::stringstream in(query_string), out;
+            std::string word;
+            bool first = true;
+            while (in >> word) {
+                if (!first) out << ' ';
+                out << word;
+                first = false;
+            }
+            return out.str();
+        }
+
+        static void erase_timing(json& answer) {
+            answer.erase("compilation-time");
+            answer.erase("reduction-time");
+            answer.erase("verification-time");
+        }
+
+        // An answer from the cache or from the previous answers was not computed in this run,
+        // so the timing and statistics of the run that computed it are not reported.
+        static void erase_work(json& answer) {
+            erase_timing(answer);
+            answer.erase("stats");
+        }
+
+        // Answer a query from the previous answers or the cache if possible, and otherwise verify it.
+        template<typename W_FN>
+        json answer_query(Builder& builder, Query& q, const std::string& query_string, bool print_timing, const W_FN& weight_fn,
+                          const utils::result_cache* cache, const json& cache_key) {
+            constexpr static bool is_weighted = pdaaal::is_weighted<typename W_FN::result_type>;
+            // An unnamed weight function cannot be compared with the one of the earlier run.
+            if (_delta != nullptr && (!is_weighted || !_cache_weight.empty())) {
+                auto it = _previous_answers.find(normalize_query(query_string));
+                if (it != _previous_answers.end() && it->second.contains("settings") && it->second["settings"] == settings()
+                    && !_delta->affects(it->second["footprint"])) {
+                    auto answer = it->second;
+                    erase_work(answer);
+                    answer.erase("cached");
+                    answer["reused"] = true;
+                    return answer;
+                }
+            }
+            auto verify = [&, this]() {
+                json res = run_once(builder, q, print_timing, weight_fn);
+                if (_print_footprint) res["settings"] = settings();
+                return res;
+            };
+            if (cache == nullptr) {
+                return verify();
+            }
+            auto key = cache_key;
+            key["query"] = normalize_query(query_string);
+            key["mode"] = q.approximation();
+            if (auto cached = cache->lookup(key)) {
+                erase_work(cached.value());
+                (*cached)["cached"] = true;
+                return cached.value();
+            }
+            json res = verify();
+            // Running out of time or memory depends on the budget and the machine, so do not remember it.
+            auto result = res["result"].get<utils::outcome_t>();
+            if (result != utils::outcome_t::TIMEOUT && result != utils::outcome_t::MEMOUT) {
+                cache->store(key, res);
+            }
+            return res;
+        }
+
+    public:
+
         template<typename W_FN = std::function<void(void)>>
         json run_once(Builder& builder, Query& q, bool print_timing = true, const W_FN& weight_fn = [](){}){
+            utils::budget_t budget(_timeout, _memory_limit);
+            if (q.failure_range()) {
+                return run_sweep(builder, q, print_timing, weight_fn, budget);
+            }
+            return verify_query(builder, q, print_timing, weight_fn, budget);
+        }
+
+    private:
+        // Verify the query for each failure bound in its range, from the lowest, until it is satisfied.
+        // Each bound is a separate run of verify_query; nothing besides the network transitions (shared by all queries) is reused.
+        // The answer is the one for the lowest bound where the query is satisfied (or the upper bound if there is none),
+        // with "failures" set to that bound and the result for each bound tried in "sweep".
+        template<typename W_FN>
+        json run_sweep(Builder& builder, Query& q, bool print_timing, const W_FN& weight_fn, utils::budget_t& budget) {
+            auto [from, to] = q.failure_range().value();
+            auto mode = q.approximation();
+            json output;
+            json sweep = json::array();
+            std::set<json> footprint;
+            double compilation_time = 0, reduction_time = 0, verification_time = 0;
+            int failures = from;
+            for (; failures <= to; ++failures) {
+                q.set_approximation(mode);
+                q.set_number_of_failures(failures);
+                output = verify_query(builder, q, true, weight_fn, budget);
+                sweep.push_back(json{{"failures", failures}, {"result", output["result"]}, {"mode", output["mode"]}});
+                compilation_time += output["compilation-time"].get<double>();
+                reduction_time += output["reduction-time"].get<double>();
+                verification_time += output["verification-time"].get<double>();
+                if (output.contains("footprint")) {
+                    footprint.insert(output["footprint"].begin(), output["footprint"].end());
+                }
+                auto result = output["result"].get<utils::outcome_t>();
+                if (result == utils::outcome_t::YES || result == utils::outcome_t::TIMEOUT || result == utils::outcome_t::MEMOUT) {
+                    break;
+                }
+            }
+            q.set_number_of_failures(std::min(failures, to));
+            output["failures"] = std::min(failures, to);
+            output["sweep"] = sweep;
+            if (_print_footprint) {
+                output["footprint"] = footprint; // The answer also depends on the bounds tried before.
+            }
+            erase_timing(output);
+            if (print_timing) {
+                output["compilation-time"] = compilation_time;
+                output["reduction-time"] = reduction_time;
+                output["verification-time"] = verification_time;
+            }
+            return output;
+        }
+
+        template<typename W_FN>
+        json verify_query(Builder& builder, Query& q, bool print_timing, const W_FN& weight_fn, utils::budget_t& budget) {
             constexpr static bool is_weighted = pdaaal::is_weighted<typename W_FN::result_type>;
 
             json output; // Store output information in this JSON object.
             static const char *engineTypes[] {"", "Post*", "Pre*"};
             output["engine"] = engineTypes[_engine];
-
-            // DUAL mode means first do OVER-approximation, then if that is inconclusive, do UNDER-approximation
-            std::vector<Query::mode_t> modes = q.approximation() == Query::DUAL ? std::vector<Query::mode_t>{Query::OVER, Query::UNDER} : std::vector<Query::mode_t>{q.approximation()};
             output["mode"] = q.approximation();
 
-            std::stringstream proof;
-            std::vector<unsigned int> trace_weight;
-            stopwatch compilation_time(false);
-            stopwatch reduction_time(false);
-            stopwatch verification_time(false);
-
-            utils::outcome_t result = utils::outcome_t::MAYBE;
-            for (auto m : modes) {
-                proof = std::stringstream(); // Clear stream from previous mode.
-
-                // Construct PDA
-                compilation_time.start();
-                q.set_approximation(m);
-                NetworkPDAFactory factory(q, builder._network, builder.all_labels(), weight_fn);
-                auto pda = factory.compile();
-                compilation_time.stop();
-
-                // Reduce PDA
-                reduction_time.start();
-                output["reduction"] = Reducer::reduce(pda, _reduction, pda.initial(), pda.terminal());
-                reduction_time.stop();
-
-                // Choose engine, run verification, and (if relevant) get the trace.
-                verification_time.start();
-                bool engine_outcome;
-                switch(_engine) {
-                    case 1: {
-                        using W = typename W_FN::result_type;
-                        SolverAdapter::res_type<W,std::less<W>,pdaaal::add<W>> solver_result;
-                        if constexpr (is_weighted) {
-                            solver_result = solver.post_star<pdaaal::Trace_Type::Shortest>(pda);
-                        } else {
-                            solver_result = solver.post_star<pdaaal::Trace_Type::Any>(pda);
-                        }
-                        engine_outcome = solver_result.first;
-                        verification_time.stop();
-                        if (engine_outcome) {
-                            std::vector<pdaaal::TypedPDA<Query::label_t>::tracestate_t > trace;
-                            if constexpr (is_weighted) {
-                                std::tie(trace, trace_weight) = solver.get_trace<pdaaal::Trace_Type::Shortest>(pda, std::move(solver_result.second));
-                            } else {
-                                trace = solver.get_trace<pdaaal::Trace_Type::Any>(pda, std::move(solver_result.second));
-                            }
-                            if (factory.write_json_trace(proof, trace))
-                                result = utils::outcome_t::YES;
+            double compilation_time = 0, reduction_time = 0, verification_time = 0;
+            std::vector<bool> footprint(builder._network.all_interfaces().size(), false);
+            json stats = json::array();
+            auto add_mode = [&](const mode_result_t& res) {
+                compilation_time += res.compilation_time.duration();
+                reduction_time += res.reduction_time.duration();
+                verification_time += res.verification_time.duration();
+                if (!res.stats.is_null()) {
+                    stats.push_back(res.stats);
+                }
+                // The answer may depend on every mode that was run, e.g. OVER being inconclusive before UNDER is tried.
+                for (size_t i = 0; i < res.footprint.size(); ++i) {
+                    if (res.footprint[i]) footprint[i] = true;
+                }
+            };
+
+            mode_result_t res;
+            if (q.approximation() == Query::DUAL && _speculative_dual) {
+                // Run OVER- and UNDER-approximation concurrently, each on its own copy of the query.
+                // Whichever is conclusive first cancels the other one.
+                // Fill the caches before the two runs read them concurrently.
+                builder.all_labels();
+                builder.transitions();
+                Query under_query = q;
+                std::atomic<bool> cancel_over{false}, cancel_under{false};
+                auto run_speculative = [&, this](Query& query, Query::mode_t m, std::atomic<bool>& cancel, std::atomic<bool>& cancel_other) {
+                    auto mode_budget = budget; // Each thread checks its own copy.
+                    mode_budget.set_cancel_flag(cancel);
+                    try {
+                        auto r = run_mode(builder, query, m, weight_fn, mode_budget);
+                        // Also stop the other run when this one ran out of budget, as it would likely do so too.
+                        if (r.result != utils::outcome_t::MAYBE) {
+                            cancel_other = true;
                         }
+                        return r;
+                    } catch (const cancelled_error&) {
+                        mode_result_t r;
+                        r.cancelled = true;
+                        return r;
+                    }
+                };
+                auto under = std::async(std::launch::async, run_speculative, std::ref(under_query), Query::UNDER, std::ref(cancel_under), std::ref(cancel_over));
+                auto over_res = run_speculative(q, Query::OVER, cancel_over, cancel_under);
+                auto under_res = under.get();
+                add_mode(over_res);
+                add_mode(under_res);
+                // Prefer the OVER result when both are conclusive, as that is what the sequential DUAL mode would report.
+                res = std::move(under_res.cancelled || (!over_res.cancelled && is_conclusive(over_res.result)) ? over_res : under_res);
+                if (is_conclusive(res.result)) {
+                    output["mode"] = res.mode;
+                }
+                if (res.result != utils::outcome_t::TIMEOUT && res.result != utils::outcome_t::MEMOUT) {
+                    output["reduction"] = res.reduction;
+                }
+            } else {
+                // DUAL mode means first do OVER-approximation, then if that is inconclusive, do UNDER-approximation
+                std::vector<Query::mode_t> modes = q.approximation() == Query::DUAL ? std::vector<Query::mode_t>{Query::OVER, Query::UNDER} : std::vector<Query::mode_t>{q.approximation()};
+                for (auto m : modes) {
+                    res = run_mode(builder, q, m, weight_fn, budget);
+                    add_mode(res);
+                    if (res.result == utils::outcome_t::TIMEOUT || res.result == utils::outcome_t::MEMOUT) {
                         break;
                     }
-                    case 2: {
-                        auto solver_result = solver.pre_star(pda, true);
-                        engine_outcome = solver_result.first;
-                        verification_time.stop();
-                        if (engine_outcome) {
-                            auto trace = solver.get_trace(pda, std::move(solver_result.second));
-                            if (factory.write_json_trace(proof, trace))
-                                result = utils::outcome_t::YES;
-                        }
+                    output["reduction"] = res.reduction;
+                    if (res.result != utils::outcome_t::MAYBE) {
+                        output["mode"] = m;
                         break;
                     }
-                    default:
-                        throw base_error("Unsupported --engine value given");
-                }
-
-                // Determine result from the outcome of verification and the mode (over/under-approximation) used.
-                if (q.number_of_failures() == 0) {
-                    result = engine_outcome ? utils::outcome_t::YES : utils::outcome_t::NO;
-                }
-                if (result == utils::outcome_t::MAYBE && m == Query::OVER && !engine_outcome) {
-                    result = utils::outcome_t::NO;
-                }
-                if (result != utils::outcome_t::MAYBE) {
-                    output["mode"] = m;
-                    break;
                 }
             }
 
-            output["result"] = result;
+            output["result"] = res.result;
 
-            if (_print_trace && result == utils::outcome_t::YES) {
+            if (_print_trace && res.result == utils::outcome_t::YES) {
                 if constexpr (is_weighted) {
-                    output["trace-weight"] = trace_weight;
+                    output["trace-weight"] = res.trace_weight;
                 }
-                std::stringstream trace;
-                trace << "[" << proof.str() << "]"; // TODO: Make NetworkPDAFactory::write_json_trace return a json object instead of ad-hoc formatting to a stringstream.
-                output["trace"] = json::parse(trace.str());
+                output["trace"] = res.proof;
+            }
+            if (_print_footprint) {
+                output["footprint"] = NetworkDelta::footprint_to_json(builder._network, footprint);
+            }
+            if (_print_stats) {
+                output["stats"] = stats;
             }
             if (print_timing) {
-                output["compilation-time"] = compilation_time.duration();
-                output["reduction-time"] = reduction_time.duration();
-                output["verification-time"] = verification_time.duration();
+                output["compilation-time"] = compilation_time;
+                output["reduction-time"] = reduction_time;
+                output["verification-time"] = verification_time;
             }
 
             return output;
         }
 
-    private:
+        struct mode_result_t {
+            Query::mode_t mode = Query::OVER;
+            utils::outcome_t result = utils::outcome_t::MAYBE;
+            bool cancelled = false;
+            json proof = json::array();
+            std::vector<unsigned int> trace_weight;
+            std::pair<size_t,size_t> reduction;
+            std::vector<bool> footprint;
+            json stats;
+            stopwatch compilation_time{false};
+            stopwatch reduction_time{false};
+            stopwatch verification_time{false};
+        };
+
+        static bool is_conclusive(utils::outcome_t result) {
+            return result == utils::outcome_t::YES || result == utils::outcome_t::NO;
+        }
+
+        // Construct, reduce and solve the PDA for a single approximation mode.
+        // Running out of time or memory gives the result TIMEOUT or MEMOUT, while cancellation is passed on as a cancelled_error.
+        template<typename W_FN>
+        mode_result_t run_mode(Builder& builder, Query& q, Query::mode_t m, const W_FN& weight_fn, utils::budget_t& budget) {
+            mode_result_t res;
+            res.mode = m;
+            // The peak memory is only per mode if the high-water mark of the process can be reset here. The reset is for the
+            // whole process, so it is skipped when other queries or modes may run at the same time, as it would wipe their peak.
+            bool concurrent = _threads > 1 || _speculative_dual;
+            bool peak_reset = _print_stats && !concurrent && reset_peak_memory_usage();
+            try {
+                verify_mode(builder, q, weight_fn, budget, res);
+            } catch (const timeout_error&) {
+                res.result = utils::outcome_t::TIMEOUT;
+            } catch (const memout_error&) {
+                res.result = utils::outcome_t::MEMOUT;
+            }
+            res.compilation_time.stop();
+            res.reduction_time.stop();
+            res.verification_time.stop();
+            if (_print_stats && !res.stats.is_null()) {
+                // The memory of the whole process, so it includes the network and whatever runs at the same time.
+                res.stats[peak_reset ? "peak-memory" : "process-peak-memory"] = peak_memory_usage();
+            }
+            return res;
+        }
+
+        // Number of states and edges reachable from the initial states.
+        static json nfa_stats(const pdaaal::NFA<Query::label_t>& nfa) {
+            std::unordered_set<const pdaaal::NFA<Query::label_t>::state_t*> seen(nfa.initial().begin(), nfa.initial().end());
+            std::vector<const pdaaal::NFA<Query::label_t>::state_t*> waiting(nfa.initial().begin(), nfa.initial().end());
+            size_t edges = 0;
+            while (!waiting.empty()) {
+                auto state = waiting.back();
+                waiting.pop_back();
+                edges += state->_edges.size();
+                for (const auto& e : state->_edges) {
+                    if (seen.insert(e._destination).second) {
+                        waiting.push_back(e._destination);
+                    }
+                }
+            }
+            return json{{"states", seen.size()}, {"edges", edges}};
+        }
+
+        template<typename W_FN>
+        void verify_mode(Builder& builder, Query& q, const W_FN& weight_fn, utils::budget_t& budget, mode_result_t& res) {
+            constexpr static bool is_weighted = pdaaal::is_weighted<typename W_FN::result_type>;
+            auto m = res.mode;
+
+            // Construct PDA
+            res.compilation_time.start();
+            q.set_approximation(m);
+            NetworkPDAFactory factory(q, builder._network, builder.all_labels(), builder.transitions(), weight_fn);
+            factory.set_budget(budget);
+            factory.set_pruning(!_no_pruning);
+            auto pda = factory.compile();
+            res.compilation_time.stop();
+            res.footprint = factory.footprint();
+            if (_print_stats) {
+                res.stats["mode"] = m;
+                res.stats["pda-states"] = factory.number_of_states();
+                res.stats["pda-rules"] = factory.number_of_rules();
+                res.stats["initial-states"] = factory.number_of_initial_states();
+                res.stats["state-table-bytes"] = factory.state_table_bytes();
+                res.stats["nfa"] = json{{"construction", nfa_stats(q.construction())}, {"path", nfa_stats(q.path())}, {"destruction", nfa_stats(q.destruction())}};
+            }
+            budget.check();
+
+            // Reduce PDA
+            res.reduction_time.start();
+            res.reduction = Reducer::reduce(pda, _reduction, pda.initial(), pda.terminal());
+            res.reduction_time.stop();
+            budget.check();
+
+            // Choose engine, run verification, and (if relevant) get the trace.
+            // Without failures the outcome of the engine is the answer, so unless a trace is printed we only need a yes/no
+            // from the engine. With failures the trace must be checked against the failure bound, so it is always needed.
+            bool need_trace = _print_trace || q.number_of_failures() > 0;
+            res.verification_time.start();
+            SolverAdapter solver;
+            bool engine_outcome;
+            switch(_engine) {
+                case 1: {
+                    using W = typename W_FN::result_type;
+                    SolverAdapter::res_type<W,std::less<W>,pdaaal::add<W>> solver_result;
+                    if (!need_trace) {
+                        solver_result = solver.post_star<pdaaal::Trace_Type::None>(pda);
+                    } else if constexpr (is_weighted) {
+                        solver_result = solver.post_star<pdaaal::Trace_Type::Shortest>(pda);
+                    } else {
+                        solver_result = solver.post_star<pdaaal::Trace_Type::Any>(pda);
+                    }
+                    engine_outcome = solver_result.first;
+                    res.verification_time.stop();
+                    budget.check();
+                    if (engine_outcome && need_trace) {
+                        std::vector<pdaaal::TypedPDA<Query::label_t>::tracestate_t > trace;
+                        if constexpr (is_weighted) {
+                            std::tie(trace, res.trace_weight) = solver.get_trace<pdaaal::Trace_Type::Shortest>(pda, std::move(solver_result.second));
+                        } else {
+                            trace = solver.get_trace<pdaaal::Trace_Type::Any>(pda, std::move(solver_result.second));
+                        }
+                        if (factory.write_json_trace(res.proof, trace))
+                            res.result = utils::outcome_t::YES;
+                    }
+                    break;
+                }
+                case 2: {
+                    auto solver_result = solver.pre_star(pda, need_trace);
+                    engine_outcome = solver_result.first;
+                    res.verification_time.stop();
+                    budget.check();
+                    if (engine_outcome && need_trace) {
+                        auto trace = solver.get_trace(pda, std::move(solver_result.second));
+                        if (factory.write_json_trace(res.proof, trace))
+                            res.result = utils::outcome_t::YES;
+                    }
+                    break;
+                }
+                default:
+                    throw base_error("Unsupported --engine value given");
+            }
+
+            if (_print_stats) {
+                res.stats["concretization-attempts"] = factory.concretization_attempts();
+            }
+
+            // Determine result from the outcome of verification and the mode (over/under-approximation) used.
+            if (q.number_of_failures() == 0) {
+                res.result = engine_outcome ? utils::outcome_t::YES : utils::outcome_t::NO;
+            }
+            if (res.result == utils::outcome_t::MAYBE && m == Query::OVER && !engine_outcome) {
+                res.result = utils::outcome_t::NO;
+            }
+        }
+
         po::options_description verification;
 
         // Settings
         size_t _engine = 1;
         size_t _reduction = 0;
         bool _print_trace = false;
-
-        // Solver engines
-        SolverAdapter solver;
+        bool _speculative_dual = false;
+        double _timeout = 0;
+        size_t _memory_limit = 0;
+        std::string _cache_dir;
+        std::string _cache_weight;
+        bool _print_footprint = false;
+        bool _print_stats = false;
+        bool _no_pruning = false;
+        std::unordered_map<std::string, json> _previous_answers;
+        const NetworkDelta* _delta = nullptr;
+        size_t _threads = 1;
     };
 
 }
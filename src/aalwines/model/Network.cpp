@@ -112,6 +112,12 @@ namespace aalwines {
         }
     }
 
+    void Network::share_identical_tables() {
+        for (const auto& router : _routers) {
+            router->share_identical_tables();
+        }
+    }
+
     const char* empty_string = "";
 
     std::unordered_set<size_t> Network::interfaces(filter_t& filter) {
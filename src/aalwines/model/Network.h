@@ -90,6 +90,8 @@ namespace aalwines {
         std::unordered_set<Query::label_t> interfaces(filter_t& filter);
 
         void add_null_router();
+        // Shares routing tables with the same content between the interfaces of each router. Called after parsing.
+        void share_identical_tables();
 
         void inject_network(Interface* link, Network&& nested_network, Interface* nested_ingoing,
                             Interface* nested_outgoing, RoutingTable::label_t pre_label, RoutingTable::label_t post_label);
@@ -0,0 +1,108 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   NetworkDelta.cpp
+ */
+
+#include "NetworkDelta.h"
+#include <aalwines/model/builders/AalWiNesBuilder.h>
+#include <aalwines/query/QueryBuilder.h>
+
+namespace aalwines {
+
+    NetworkDelta::NetworkDelta(const json& j) {
+        if (!j.is_object() || !j.contains("changes") || !j["changes"].is_array()) {
+            throw base_error("error: Network delta must be an object with a \"changes\" array.");
+        }
+        for (const auto& json_change : j["changes"]) {
+            change_t change;
+            change._router = json_change.at("router").get<std::string>();
+            change._interface = json_change.at("interface").get<std::string>();
+            change._label = json_change.at("label").get<std::string>();
+            if (json_change.contains("rules") && !json_change["rules"].is_null()) {
+                if (!json_change["rules"].is_array()) {
+                    throw base_error("error: \"rules\" of a network delta change must be an array or null.");
+                }
+                change._rules = json_change["rules"];
+            }
+            _changes.emplace_back(std::move(change));
+        }
+    }
+
+    void NetworkDelta::apply(Network& network) {
+        auto labels_before = Builder(network).all_labels();
+        _network = &network;
+        _changed.assign(network.all_interfaces().size(), false);
+        std::stringstream es;
+        for (const auto& change : _changes) {
+            auto router = network.find_router(change._router);
+            if (router == nullptr) {
+                es << "error: No router with name \"" << change._router << "\" was defined." << std::endl;
+                throw base_error(es.str());
+            }
+            auto interface = router->find_interface(change._interface);
+            if (interface == nullptr) {
+                es << "error: No interface with name \"" << change._interface << "\" was defined for router \"" << change._router << "\"." << std::endl;
+                throw base_error(es.str());
+            }
+            auto top_label = RoutingTable::entry_t(change._label)._top_label;
+            if (change._rules) {
+                std::vector<RoutingTable::forward_t> rules;
+                for (const auto& json_rule : change._rules.value()) {
+                    auto via = router->find_interface(json_rule.at("out").get<std::string>());
+                    if (via == nullptr) {
+                        es << "error: No interface with name \"" << json_rule.at("out").get<std::string>() << "\" was defined for router \"" << change._router << "\"." << std::endl;
+                        throw base_error(es.str());
+                    }
+                    auto ops = json_rule.at("ops").get<std::vector<RoutingTable::action_t>>();
+                    auto priority = json_rule.at("priority").get<size_t>();
+                    auto weight = json_rule.contains("weight") ? json_rule.at("weight").get<uint32_t>() : 0;
+                    rules.emplace_back(std::move(ops), via, priority, weight);
+                }
+                interface->table().replace_rules(top_label, std::move(rules));
+            } else {
+                interface->table().remove_entry(top_label);
+            }
+            _changed[interface->global_id()] = true;
+        }
+        _labels_changed = Builder(network).all_labels() != labels_before;
+    }
+
+    bool NetworkDelta::affects(const json& footprint) const {
+        assert(_network != nullptr || _changes.empty());
+        if (_labels_changed) return true;
+        if (_changes.empty()) return false;
+        for (const auto& json_interface : footprint) {
+            auto router = _network->find_router(json_interface.at(0).get<std::string>());
+            auto interface = router == nullptr ? nullptr : router->find_interface(json_interface.at(1).get<std::string>());
+            if (interface == nullptr || is_changed(interface)) {
+                return true; // Unknown interfaces are treated as changed.
+            }
+        }
+        return false;
+    }
+
+    nlohmann::json NetworkDelta::footprint_to_json(const Network& network, const std::vector<bool>& footprint) {
+        auto result = json::array();
+        for (const auto* interface : network.all_interfaces()) {
+            if (interface->global_id() < footprint.size() && footprint[interface->global_id()]) {
+                result.push_back({interface->source()->name(), interface->source()->interface_name(interface->id())});
+            }
+        }
+        return result;
+    }
+
+}
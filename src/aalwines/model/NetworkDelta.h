@@ -0,0 +1,74 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   NetworkDelta.h
+ *
+ * A set of changes to routing table entries, in the format
+ *   {"changes": [{"router": "R0", "interface": "i1", "label": "42", "rules": [{"out": "i2", "ops": [...], "priority": 0}]},
+ *                {"router": "R0", "interface": "i1", "label": "43", "rules": null}]}
+ * where "rules" replaces the rules of the entry (adding it if needed), and a null or missing "rules" removes the entry.
+ * After the delta is applied, it can tell whether a query answer depends on any of the changed interfaces,
+ * using the footprint (the interfaces whose routing tables the query's PDA was built from) stored with the answer.
+ */
+
+#ifndef AALWINES_NETWORKDELTA_H
+#define AALWINES_NETWORKDELTA_H
+
+#include "Network.h"
+#include <json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace aalwines {
+
+    class NetworkDelta {
+        using json = nlohmann::json;
+    public:
+        NetworkDelta() = default;
+        explicit NetworkDelta(const json& j);
+
+        // Apply the changes to the routing tables of network. Throws base_error if a router or interface does not exist.
+        void apply(Network& network);
+
+        [[nodiscard]] bool empty() const { return _changes.empty(); }
+        // True if the changes added labels to, or removed labels from, the network. All queries may then be affected.
+        [[nodiscard]] bool labels_changed() const { return _labels_changed; }
+        [[nodiscard]] bool is_changed(const Interface* inf) const {
+            return inf->global_id() < _changed.size() && _changed[inf->global_id()];
+        }
+        // Does the answer with the given footprint depend on a changed routing table. Must be called after apply.
+        [[nodiscard]] bool affects(const json& footprint) const;
+
+        // Footprint as stored in answers: a list of [router name, interface name] pairs.
+        static json footprint_to_json(const Network& network, const std::vector<bool>& footprint);
+
+    private:
+        struct change_t {
+            std::string _router;
+            std::string _interface;
+            std::string _label;
+            std::optional<json> _rules;
+        };
+        std::vector<change_t> _changes;
+        std::vector<bool> _changed; // Indexed by global interface id.
+        bool _labels_changed = false;
+        Network* _network = nullptr;
+    };
+
+}
+
+#endif //AALWINES_NETWORKDELTA_H
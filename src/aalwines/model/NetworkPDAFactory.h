@@ -29,6 +29,10 @@
 
 #include "Query.h"
 #include "Network.h"
+#include "NetworkTransitions.h"
+#include <aalwines/utils/budget.h>
+#include <aalwines/utils/flat_index.h>
+#include <aalwines/utils/dense_bitset.h>
 #include <pdaaal/PDAFactory.h>
 
 
@@ -51,26 +55,87 @@ namespace aalwines {
             int32_t _rid = 0; // which rule in that entry
             NFA::state_t *_nfastate = nullptr;
             const Interface *_inf = nullptr;
-        } __attribute__((packed)); // packed is needed to make this work fast with ptries
+
+            bool operator==(const nstate_t& other) const {
+                return _appmode == other._appmode && _opid == other._opid && _eid == other._eid && _rid == other._rid &&
+                       _nfastate == other._nfastate && _inf == other._inf;
+            }
+        };
+        // The routing table entry and forward that a rule from a clean state to a clean state was made from.
+        struct provenance_t {
+            size_t _dest = 0;
+            label_t _pre = 0; // Not used if the entry ignores the label.
+            int32_t _eid = 0;
+            int32_t _rid = 0;
+            bool _ignores_label = false;
+        };
+        // A clean state without the approximation mode, i.e. a node of the product of the interface graph and the path NFA.
+        struct location_t {
+            NFA::state_t *_nfastate = nullptr;
+            const Interface *_inf = nullptr;
+            bool operator==(const location_t& other) const {
+                return _nfastate == other._nfastate && _inf == other._inf;
+            }
+        };
+        struct location_hash {
+            size_t operator()(const location_t& l) const {
+                return nstate_hash::mix(reinterpret_cast<uintptr_t>(l._nfastate) ^ nstate_hash::mix(reinterpret_cast<uintptr_t>(l._inf)));
+            }
+        };
+        struct nstate_hash {
+            size_t operator()(const nstate_t& s) const {
+                // The state table uses the low bits, so mix all fields into them.
+                uint64_t h = reinterpret_cast<uintptr_t>(s._nfastate);
+                h = mix(h ^ reinterpret_cast<uintptr_t>(s._inf));
+                h = mix(h ^ ((uint64_t)(uint32_t)s._appmode << 32 | (uint32_t)s._opid));
+                h = mix(h ^ ((uint64_t)(uint32_t)s._eid << 32 | (uint32_t)s._rid));
+                return h;
+            }
+            static uint64_t mix(uint64_t h) { // Finalizer of splitmix64.
+                h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+                return h ^ (h >> 31);
+            }
+        };
     public:
         NetworkPDAFactory(Query &query, Network &network, Builder::labelset_t&& all_labels)
         : NetworkPDAFactory(query, network, std::move(all_labels), [](){}) {};
 
         NetworkPDAFactory(Query &query, Network &network, Builder::labelset_t&& all_labels, const W_FN& weight_f)
-        :PDAFactory(query.construction(), query.destruction(), std::move(all_labels), Query::unused_label()), _network(network),
-        _query(query), _path(query.path()), _weight_f(weight_f){
-            NFA::state_t *ns = nullptr;
-            Interface *nr = nullptr;
-            add_state(ns, nr);
-            add_state(ns, nr, -1); // Add a second (different) NULL state.
-            _path.compile();
-            construct_initial();
-        };
+        : NetworkPDAFactory(query, network, std::move(all_labels), std::make_unique<const NetworkTransitions>(network), nullptr, weight_f) {};
+
+        // Use transitions compiled in advance for the network (see Builder::transitions), instead of building them for this query.
+        NetworkPDAFactory(Query &query, Network &network, Builder::labelset_t&& all_labels, const NetworkTransitions& transitions)
+        : NetworkPDAFactory(query, network, std::move(all_labels), transitions, [](){}) {};
+
+        NetworkPDAFactory(Query &query, Network &network, Builder::labelset_t&& all_labels, const NetworkTransitions& transitions, const W_FN& weight_f)
+        : NetworkPDAFactory(query, network, std::move(all_labels), nullptr, &transitions, weight_f) {};
 
         [[nodiscard]] std::function<void(std::ostream &, const Query::label_t &)> label_writer() const;
 
+        // Append the steps of the concretized trace to the JSON array trace_out. Returns false if the trace is not a real one.
+        bool write_json_trace(json &trace_out, std::vector<PDA::tracestate_t> &trace);
         bool write_json_trace(std::ostream &stream, std::vector<PDA::tracestate_t> &trace);
 
+        // The budget is checked for every state expanded, and construction is abandoned by the exception it throws.
+        void set_budget(utils::budget_t& budget) { _budget = &budget; }
+
+        // Pruning of the locations that cannot reach the end of the path, and of the labels that cannot be on top
+        // of the stack at an interface, is on by default. Turning it off is for testing, and must be done before compile().
+        void set_pruning(bool prune) { _prune = prune; }
+
+        // The interfaces (by global id) whose routing tables were used in the construction so far.
+        // Changes to other routing tables cannot change the constructed PDA.
+        [[nodiscard]] const std::vector<bool>& footprint() const { return _footprint; }
+
+        // Statistics of the construction (and concretization) so far.
+        [[nodiscard]] size_t number_of_states() const { return _states.size(); }
+        [[nodiscard]] size_t number_of_rules() const { return _num_rules; }
+
+        [[nodiscard]] size_t number_of_initial_states() const { return _initial.size(); }
+        [[nodiscard]] size_t state_table_bytes() const { return _states.memory_usage() + _accepting.capacity() / 8; }
+        // Number of rules checked against the failure bound while concretizing traces.
+        [[nodiscard]] size_t concretization_attempts() const { return _concretization_attempts; }
 
     protected:
         const std::vector<size_t> &initial() override;
@@ -79,36 +144,94 @@ namespace aalwines {
 
         bool accepting(size_t) override;
 
+        // PDAFactory takes the rules of each state as a new vector, so they are collected in a reused buffer
+        // and copied out in one allocation of the right size.
         std::vector<rule_t> rules(size_t) override;
 
-        void expand_back(std::vector<rule_t> &rules);
+        // Append the rules from the PDA state id to result. Only for rules(), as it also updates the provenance and rule count.
+        void append_rules(size_t id, std::vector<rule_t>& result);
+
+        // Replace the last rule, which has a wildcard pre label, by one rule for each label that can be on top of the stack on inf.
+        void expand_back(std::vector<rule_t> &rules, const Interface* inf);
 
+        // The approximation mode is the same for all states of the factory, so it is chosen once per state
+        // and the code for each mode is specialized at compile time.
+        template<Query::mode_t MODE>
+        void mode_rules(size_t id, std::vector<rule_t>& result);
+
+        template<Query::mode_t MODE>
         bool
-        start_rule(size_t id, nstate_t &s, const RoutingTable::forward_t &forward, const RoutingTable::entry_t &entry,
+        start_rule(size_t id, const nstate_t &s, const NetworkTransitions::forward_t &forward, const NetworkTransitions::entry_t &entry,
                    NFA::state_t *destination, std::vector<rule_t> &result);
 
     private:
+        NetworkPDAFactory(Query &query, Network &network, Builder::labelset_t&& all_labels,
+                          std::unique_ptr<const NetworkTransitions>&& own_transitions, const NetworkTransitions* transitions, const W_FN& weight_f)
+        :PDAFactory(query.construction(), query.destruction(), std::move(all_labels), Query::unused_label()), _network(network),
+        _query(query), _path(query.path()), _own_transitions(std::move(own_transitions)),
+        _transitions(transitions != nullptr ? *transitions : *_own_transitions), _weight_f(weight_f),
+        _footprint(network.all_interfaces().size(), false){
+            _states.reserve(network.all_interfaces().size()); // At least one state per interface is typical.
+            _labels.assign(this->_all_labels.begin(), this->_all_labels.end());
+            std::sort(_labels.begin(), _labels.end());
+            NFA::state_t *ns = nullptr;
+            Interface *nr = nullptr;
+            add_state(ns, nr);
+            add_state(ns, nr, -1); // Add a second (different) NULL state.
+            _path.compile();
+        };
+
         bool
         add_interfaces(std::unordered_set<const Interface *> &disabled, std::unordered_set<const Interface *> &active,
-                       const RoutingTable::entry_t &entry, const RoutingTable::forward_t &fwd) const;
+                       const NetworkTransitions::forward_t &fwd) const;
 
-        void print_trace_rule(std::ostream &stream, const Interface *inf, const RoutingTable::entry_t &entry,
-                              const RoutingTable::forward_t &rule) const;
+        json trace_rule(const Interface *inf, const NetworkTransitions::entry_t &entry,
+                              const NetworkTransitions::forward_t &rule) const;
 
         void construct_initial();
 
+        // Find the locations from which an accepting location can be reached, looking only at the topology
+        // and the path NFA (not at labels or failures), searching from the given initial locations.
+        void compute_productive(const std::vector<location_t>& initial);
+        // Find the labels that can be on top of the stack when a packet arrives on each interface of a productive location,
+        // from the labels the pre-condition allows and the operations of the routing tables.
+        void compute_label_flow(const std::vector<location_t>& initial);
+        [[nodiscard]] bool can_be_top(const Interface* inf, label_t label) const {
+            if (_any_top_label[inf->global_id()]) return true;
+            auto lb = std::lower_bound(_labels.begin(), _labels.end(), label);
+            return lb != _labels.end() && *lb == label && _top_labels[inf->global_id()].test(lb - _labels.begin());
+        }
+        [[nodiscard]] bool is_productive(NFA::state_t* state, const Interface* inf) const {
+            if (!_prune) return true;
+            auto res = _locations.exists(location_t{state, inf});
+            return res.first && _productive[res.second];
+        }
+        // Calls fn(nfa state, interface) for each location reached in one step from the location, ignoring labels.
+        template<typename FN>
+        void for_each_successor(const location_t& location, FN&& fn);
+
+        // The interfaces (by global id) matched by each edge of the path NFA state, built on first use.
+        const std::vector<utils::dense_bitset>& edge_interfaces(const NFA::state_t* state);
+
         std::pair<bool, size_t>
         add_state(NFA::state_t *state, const Interface *inf, int32_t mode = 0, int32_t eid = 0, int32_t fid = 0, int32_t op = -1);
 
-        int32_t set_approximation(const nstate_t &state, const RoutingTable::forward_t &forward);
+        // Add the states between the operations of forward fid of entry eid as one block, so the state after the
+        // operation op has the id of the first state plus op. Returns the first state.
+        std::pair<bool, size_t>
+        add_op_chain(NFA::state_t *state, const Interface *inf, int32_t mode, int32_t eid, int32_t fid, size_t length);
+
+        // The approximation mode of the state after a forward with the priority, or max int32 if the failure bound is exceeded.
+        template<Query::mode_t MODE>
+        int32_t set_approximation(const nstate_t &state, size_t priority);
 
-        bool concreterize_trace(std::ostream &stream, const std::vector<PDA::tracestate_t> &trace,
-                                std::vector<const RoutingTable::entry_t *> &entries,
-                                std::vector<const RoutingTable::forward_t *> &rules);
+        bool concreterize_trace(json &trace_out, const std::vector<PDA::tracestate_t> &trace,
+                                std::vector<const NetworkTransitions::entry_t *> &entries,
+                                std::vector<const NetworkTransitions::forward_t *> &rules);
 
-        void write_concrete_trace(std::ostream &stream, const std::vector<PDA::tracestate_t> &trace,
-                                  std::vector<const RoutingTable::entry_t *> &entries,
-                                  std::vector<const RoutingTable::forward_t *> &rules);
+        void write_concrete_trace(json &trace_out, const std::vector<PDA::tracestate_t> &trace,
+                                  std::vector<const NetworkTransitions::entry_t *> &entries,
+                                  std::vector<const NetworkTransitions::forward_t *> &rules);
 
         //void substitute_wildcards(std::vector<PDA::tracestate_t> &trace,
         //                          std::vector<const RoutingTable::entry_t *> &entries,
@@ -118,55 +241,275 @@ namespace aalwines {
         Query &_query;
         NFA &_path;
         std::vector<size_t> _initial;
-        ptrie::map<nstate_t, bool> _states;
+        utils::flat_index<nstate_t, nstate_hash> _states;
+        std::vector<bool> _accepting; // Indexed by state id.
+        std::vector<label_t> _labels; // All labels, sorted. Label sets below are bitsets over indices in this.
+        std::vector<utils::dense_bitset> _top_labels; // Labels that can be on top of the stack on each interface.
+        std::vector<bool> _any_top_label; // Any label can be on top of the stack on the interface.
+        std::unordered_map<const Interface*, std::vector<label_t>> _top_label_lists;
+        std::unordered_map<const NFA::state_t*, std::vector<utils::dense_bitset>> _edge_interfaces;
+        std::vector<rule_t> _rule_buffer;
+        std::vector<provenance_t> _provenance; // The rules of each clean state are a consecutive range.
+        std::vector<std::pair<size_t, size_t>> _provenance_range; // Indexed by state id.
+        std::vector<NFA::state_t*> _next_buffer;
+        utils::flat_index<location_t, location_hash> _locations;
+        std::vector<bool> _productive; // Indexed by location id.
+        std::unique_ptr<const NetworkTransitions> _own_transitions;
+        const NetworkTransitions &_transitions;
         const W_FN &_weight_f;
+        utils::budget_t *_budget = nullptr;
+        std::vector<bool> _footprint;
+        bool _prune = true;
+        bool _initial_constructed = false;
+        size_t _num_rules = 0;
+        mutable size_t _concretization_attempts = 0;
     };
 
     template<typename W_FN>
     NetworkPDAFactory(Query &query, Network &network, Builder::labelset_t&& all_labels, const W_FN& weight_f) -> NetworkPDAFactory<W_FN, typename W_FN::result_type>;
 
+    template<typename W_FN>
+    NetworkPDAFactory(Query &query, Network &network, Builder::labelset_t&& all_labels, const NetworkTransitions& transitions, const W_FN& weight_f) -> NetworkPDAFactory<W_FN, typename W_FN::result_type>;
+
     template<typename W_FN, typename W>
     void NetworkPDAFactory<W_FN, W>::construct_initial() {
-        // there is potential for some serious pruning here!
+        std::vector<location_t> initial;
         auto add_initial = [&, this](NFA::state_t *state, const Interface *inf) {
             if (inf != nullptr && inf->is_virtual()) // don't start on a virtual interface.
                 return;
             std::vector<NFA::state_t *> next{state};
             NFA::follow_epsilon(next);
             for (auto &n : next) {
-                auto res = add_state(n, inf, 0, 0, 0, -1);
-                if (res.first)
-                    _initial.push_back(res.second);
+                initial.push_back(location_t{n, inf});
             }
         };
 
         for (auto i : _path.initial()) {
             // the path is one behind, we are coming from an unknown router via an OK interface
             // i.e. we have to move straight to the next state
-            for (auto &e : i->_edges) {
-                if (e.wildcard(_network.all_interfaces().size())) {
-                    for (auto inf : _network.all_interfaces()) {
+            const auto& edge_infs = edge_interfaces(i);
+            for (size_t ei = 0; ei < i->_edges.size(); ++ei) {
+                auto destination = i->_edges[ei]._destination;
+                edge_infs[ei].for_each([&](size_t iid) {
+                    add_initial(destination, _network.all_interfaces()[iid]->match());
+                });
+            }
+        }
 
-                        add_initial(e._destination, inf->match());
+        // Only start where the end of the path can be reached.
+        if (_prune) {
+            compute_productive(initial);
+            compute_label_flow(initial);
+        } else {
+            _any_top_label.assign(_network.all_interfaces().size(), true);
+        }
+        for (const auto& l : initial) {
+            if (!is_productive(l._nfastate, l._inf)) continue;
+            auto res = add_state(l._nfastate, l._inf, 0, 0, 0, -1);
+            if (res.first)
+                _initial.push_back(res.second);
+        }
+        std::sort(_initial.begin(), _initial.end());
+    }
+
+    template<typename W_FN, typename W>
+    template<typename FN>
+    void NetworkPDAFactory<W_FN, W>::for_each_successor(const location_t& location, FN&& fn) {
+        if (location._inf == nullptr) return;
+        _footprint[location._inf->global_id()] = true; // Pruning depends on this table too.
+        const auto& edge_infs = edge_interfaces(location._nfastate);
+        for (const auto& entry : _transitions.entries(location._inf)) {
+            for (const auto& forward : entry._forwards) {
+                if (forward._virtual) {
+                    fn(location._nfastate, forward._target);
+                    continue;
+                }
+                for (size_t ei = 0; ei < edge_infs.size(); ++ei) {
+                    if (!edge_infs[ei].test(forward._via_id)) continue;
+                    std::vector<NFA::state_t *> next{location._nfastate->_edges[ei]._destination};
+                    NFA::follow_epsilon(next);
+                    for (auto n : next) {
+                        fn(n, forward._target);
                     }
-                } else if (!e._negated) {
-                    for (auto s : e._symbols) {
-                        auto inf = _network.all_interfaces()[s];
-                        add_initial(e._destination, inf->match());
+                }
+            }
+        }
+    }
+
+    template<typename W_FN, typename W>
+    void NetworkPDAFactory<W_FN, W>::compute_label_flow(const std::vector<location_t>& initial) {
+        auto n = _network.all_interfaces().size();
+        _top_labels.assign(n, utils::dense_bitset());
+        _any_top_label.assign(n, false);
+        std::vector<bool> relevant(n, false), waiting_flag(n, false);
+        std::vector<size_t> waiting;
+        for (size_t id = 0; id < _locations.size(); ++id) {
+            auto inf = _locations[id]._inf;
+            if (_productive[id] && inf != nullptr && !relevant[inf->global_id()]) {
+                relevant[inf->global_id()] = true;
+                _top_labels[inf->global_id()] = utils::dense_bitset(_labels.size());
+            }
+        }
+        auto enqueue = [&](size_t iid) {
+            if (!waiting_flag[iid]) {
+                waiting_flag[iid] = true;
+                waiting.push_back(iid);
+            }
+        };
+        auto add_label = [&, this](size_t iid, label_t label) {
+            auto lb = std::lower_bound(_labels.begin(), _labels.end(), label);
+            if (lb == _labels.end() || *lb != label) return;
+            auto i = lb - _labels.begin();
+            if (!_any_top_label[iid] && !_top_labels[iid].test(i)) {
+                _top_labels[iid].set(i);
+                enqueue(iid);
+            }
+        };
+        auto add_any = [&, this](size_t iid) {
+            if (!_any_top_label[iid]) {
+                _any_top_label[iid] = true;
+                enqueue(iid);
+            }
+        };
+
+        // The construction NFA reads the initial stack from the bottom, so the top of the stack when entering the network
+        // is a label read by an edge into an accepting state.
+        bool any_initial = false;
+        std::vector<label_t> initial_labels;
+        {
+            auto& construction = _query.construction();
+            std::unordered_set<NFA::state_t*> seen(construction.initial().begin(), construction.initial().end());
+            std::vector<NFA::state_t*> states(construction.initial().begin(), construction.initial().end());
+            while (!states.empty()) {
+                auto state = states.back();
+                states.pop_back();
+                for (const auto& e : state->_edges) {
+                    std::vector<NFA::state_t*> next{e._destination};
+                    NFA::follow_epsilon(next);
+                    if (std::any_of(next.begin(), next.end(), [](const NFA::state_t* n) { return n->_accepting; })) {
+                        if (e._negated) any_initial = true;
+                        initial_labels.insert(initial_labels.end(), e._symbols.begin(), e._symbols.end());
                     }
-                } else {
-                    for (auto inf : _network.all_interfaces()) {
-                        auto iid = inf->global_id();
-                        auto lb = std::lower_bound(e._symbols.begin(), e._symbols.end(), iid);
-                        assert(std::is_sorted(e._symbols.begin(), e._symbols.end()));
-                        if (lb == std::end(e._symbols) || *lb != iid) {
-                            add_initial(e._destination, inf->match());
+                    for (auto n : next) {
+                        if (seen.insert(n).second) states.push_back(n);
+                    }
+                }
+            }
+        }
+        for (const auto& l : initial) {
+            if (l._inf == nullptr || !relevant[l._inf->global_id()]) continue;
+            if (any_initial) {
+                add_any(l._inf->global_id());
+            } else {
+                for (auto label : initial_labels) add_label(l._inf->global_id(), label);
+            }
+        }
+
+        while (!waiting.empty()) {
+            auto iid = waiting.back();
+            waiting.pop_back();
+            waiting_flag[iid] = false;
+            const auto* inf = _network.all_interfaces()[iid];
+            for (const auto& entry : _transitions.entries(inf)) {
+                if (entry._ignores_label ? (!_any_top_label[iid] && _top_labels[iid].none()) : !can_be_top(inf, entry._top_label))
+                    continue;
+                for (const auto& forward : entry._forwards) {
+                    if (forward._target == nullptr || !relevant[forward._target->global_id()]) continue;
+                    auto tid = forward._target->global_id();
+                    // The top of the stack after the operations: unchanged, a known label, or anything (after a pop).
+                    enum { same, known, any } top = same;
+                    label_t label = 0;
+                    for (const auto& op : forward._ops) {
+                        switch (op._op) {
+                            case pdaaal::SWAP:
+                            case pdaaal::PUSH:
+                                if (top != any) {
+                                    top = known;
+                                    label = op._op_label;
+                                }
+                                break;
+                            case pdaaal::POP:
+                                top = any;
+                                break;
+                            default:
+                                break;
                         }
                     }
+                    if (top == any || (top == same && entry._ignores_label && _any_top_label[iid])) {
+                        add_any(tid);
+                    } else if (top == known) {
+                        add_label(tid, label);
+                    } else if (!entry._ignores_label) {
+                        add_label(tid, entry._top_label);
+                    } else if (!_any_top_label[tid] && _top_labels[tid].merge(_top_labels[iid])) {
+                        enqueue(tid);
+                    }
                 }
             }
         }
-        std::sort(_initial.begin(), _initial.end());
+    }
+
+    template<typename W_FN, typename W>
+    void NetworkPDAFactory<W_FN, W>::compute_productive(const std::vector<location_t>& initial) {
+        // Forward search from the initial locations, remembering the predecessors of each location.
+        std::vector<std::vector<uint32_t>> predecessors;
+        std::vector<size_t> waiting;
+        auto add = [&, this](const location_t& l) {
+            auto res = _locations.insert(l);
+            if (res.first) {
+                predecessors.emplace_back();
+                waiting.push_back(res.second);
+            }
+            return res.second;
+        };
+        for (const auto& l : initial) {
+            add(l);
+        }
+        while (!waiting.empty()) {
+            auto id = waiting.back();
+            waiting.pop_back();
+            auto location = _locations[id];
+            for_each_successor(location, [&](NFA::state_t* n, const Interface* inf) {
+                auto succ = add(location_t{n, inf});
+                predecessors[succ].push_back(id);
+            });
+        }
+        // Backward search from the accepting locations among those found.
+        _productive.assign(_locations.size(), false);
+        for (size_t id = 0; id < _locations.size(); ++id) {
+            const auto& l = _locations[id];
+            if (l._nfastate->_accepting && (l._inf == nullptr || !l._inf->is_virtual())) {
+                _productive[id] = true;
+                waiting.push_back(id);
+            }
+        }
+        while (!waiting.empty()) {
+            auto id = waiting.back();
+            waiting.pop_back();
+            for (auto pred : predecessors[id]) {
+                if (!_productive[pred]) {
+                    _productive[pred] = true;
+                    waiting.push_back(pred);
+                }
+            }
+        }
+    }
+
+    template<typename W_FN, typename W>
+    const std::vector<utils::dense_bitset>& NetworkPDAFactory<W_FN, W>::edge_interfaces(const NFA::state_t* state) {
+        auto [it, inserted] = _edge_interfaces.try_emplace(state);
+        if (inserted) {
+            auto n = _network.all_interfaces().size();
+            for (const auto& e : state->_edges) {
+                // A negated edge matches every interface not among its symbols.
+                auto& bits = it->second.emplace_back(n, e._negated);
+                for (auto symbol : e._symbols) {
+                    if (e._negated) bits.reset(symbol);
+                    else bits.set(symbol);
+                }
+            }
+        }
+        return it->second;
     }
 
     template<typename W_FN, typename W>
@@ -181,10 +524,20 @@ namespace aalwines {
         ns._eid = eid;
         auto res = _states.insert(ns);
         if (res.first) {
-            if (res.second > 1) {
-                // don't check null-state
-                auto &d = _states.get_data(res.second);
-                d = op == -1 && (inf == nullptr || !inf->is_virtual()) && state->_accepting;
+            // don't check null-state
+            _accepting.push_back(res.second > 1 && op == -1 && (inf == nullptr || !inf->is_virtual()) && state->_accepting);
+        }
+        return res;
+    }
+
+    template<typename W_FN, typename W>
+    std::pair<bool, size_t>
+    NetworkPDAFactory<W_FN, W>::add_op_chain(NFA::state_t *state, const Interface *inf, int32_t mode, int32_t eid, int32_t fid, size_t length) {
+        auto res = add_state(state, inf, mode, eid, fid, 0);
+        if (res.first) {
+            // The rest of the chain is only ever added here, right after its first state, so the ids are consecutive.
+            for (size_t op = 1; op < length; ++op) {
+                add_state(state, inf, mode, eid, fid, op);
             }
         }
         return res;
@@ -192,6 +545,11 @@ namespace aalwines {
 
     template<typename W_FN, typename W>
     const std::vector<size_t> &NetworkPDAFactory<W_FN, W>::initial() {
+        // Constructed on first use rather than in the constructor, so the pruning can be turned off before.
+        if (!_initial_constructed) {
+            construct_initial();
+            _initial_constructed = true;
+        }
         return _initial;
     }
 
@@ -206,89 +564,66 @@ namespace aalwines {
 
     template<typename W_FN, typename W>
     bool NetworkPDAFactory<W_FN, W>::accepting(size_t i) {
-        return _states.get_data(i);
+        return _accepting[i];
     }
 
     template<typename W_FN, typename W>
-    int32_t NetworkPDAFactory<W_FN, W>::set_approximation(const nstate_t &state, const RoutingTable::forward_t &forward) {
+    template<Query::mode_t MODE>
+    int32_t NetworkPDAFactory<W_FN, W>::set_approximation(const nstate_t &state, size_t priority) {
+        static_assert(MODE == Query::OVER || MODE == Query::UNDER, "Only OVER and UNDER approximation is supported");
         auto num_fail = _query.number_of_failures();
         auto err = std::numeric_limits<int32_t>::max();
-        switch (_query.approximation()) {
-            case Query::OVER:
-                if ((int) forward._priority > num_fail)
-                    return err;
-                else
-                    return 0;
-            case Query::UNDER: {
-                auto nm = state._appmode + forward._priority;
-                if ((int) nm > num_fail)
-                    return err;
-                else
-                    return nm;
-            }
-            case Query::EXACT:
-            case Query::DUAL:
-            default:
-                return err;
+        if constexpr (MODE == Query::OVER) {
+            return (int) priority > num_fail ? err : 0;
+        } else {
+            auto nm = state._appmode + priority;
+            return (int) nm > num_fail ? err : nm;
         }
     }
 
     template<typename W_FN, typename W>
-    bool NetworkPDAFactory<W_FN, W>::start_rule(size_t id, nstate_t &s, const RoutingTable::forward_t &forward,
-                                             const RoutingTable::entry_t &entry, NFA::state_t *destination,
+    template<Query::mode_t MODE>
+    bool NetworkPDAFactory<W_FN, W>::start_rule(size_t id, const nstate_t &s, const NetworkTransitions::forward_t &forward,
+                                             const NetworkTransitions::entry_t &entry, NFA::state_t *destination,
                                              std::vector<NetworkPDAFactory::rule_t> &result) {
         rule_t nr;
         auto appmode = s._appmode;
-        if (!forward._via->is_virtual()) {
-            appmode = set_approximation(s, forward);
+        if (!forward._virtual) {
+            appmode = set_approximation<MODE>(s, forward._priority);
             if (appmode == std::numeric_limits<int32_t>::max())
                 return false;
         }
-        if (!forward._ops.empty()) {
-            switch (forward._ops[0]._op) {
-                case RoutingTable::op_t::POP:
-                    nr._op = pdaaal::POP;
-                    break;
-                case RoutingTable::op_t::PUSH:
-                    nr._op = pdaaal::PUSH;
-                    nr._op_label = forward._ops[0]._op_label;
-                    break;
-                case RoutingTable::op_t::SWAP:
-                    nr._op = pdaaal::SWAP;
-                    nr._op_label = forward._ops[0]._op_label;
-                    break;
-            }
-        } else {
-            if (!entry.ignores_label()) {
-                nr._op = pdaaal::SWAP;
-                nr._op_label = entry._top_label;
-            } else {
-                nr._op = pdaaal::NOOP;
-            }
-        }
+        nr._op = forward._ops[0]._op;
+        nr._op_label = forward._ops[0]._op_label;
 
-        std::vector<NFA::state_t *> next{destination};
-        if (forward._via->is_virtual())
-            next = {s._nfastate};
-        else
+        auto& next = _next_buffer;
+        next.clear();
+        if (forward._virtual) {
+            next.push_back(s._nfastate);
+        } else {
+            next.push_back(destination);
             NFA::follow_epsilon(next);
+        }
         for (auto &n : next) {
+            if (!is_productive(n, forward._target)) // The end of the path cannot be reached from here.
+                continue;
             result.emplace_back(nr);
             auto &ar = result.back();
             std::pair<bool, size_t> res;
+            auto eid = ((&entry) - _transitions.entries(s._inf).data());
+            auto rid = ((&forward) - entry._forwards.data());
             if (forward._ops.size() <= 1) {
-                res = add_state(n, forward._via->match(), appmode);
+                res = add_state(n, forward._target, appmode);
                 if constexpr (is_weighted) {
                     ar._weight = _weight_f(forward, entry);
                 }
+                _provenance.push_back(provenance_t{res.second, entry._top_label, (int32_t)eid, (int32_t)rid, entry._ignores_label});
             } else {
-                auto eid = ((&entry) - s._inf->table().entries().data());
-                auto rid = ((&forward) - entry._rules.data());
-                res = add_state(n, s._inf, appmode, eid, rid, 0);
+                res = add_op_chain(n, s._inf, appmode, eid, rid, forward._ops.size() - 1);
             }
             ar._dest = res.second;
-            if (entry.ignores_label()) {
-                expand_back(result); // TODO: Implement wildcard pre label in PDA instead of this.
+            if (entry._ignores_label) {
+                expand_back(result, s._inf); // TODO: Use a wildcard pre label in the PDA when PDAFactory supports it.
             } else {
                 ar._pre = entry._top_label;
             }
@@ -296,136 +631,130 @@ namespace aalwines {
         return true;
     }
     template<typename W_FN, typename W>
-    void NetworkPDAFactory<W_FN, W>::expand_back(std::vector<rule_t>& rules) {
-        rule_t cpy;
-        std::swap(rules.back(), cpy);
+    void NetworkPDAFactory<W_FN, W>::expand_back(std::vector<rule_t>& rules, const Interface* inf) {
+        // The rules of PDAFactory have a single pre label, so the wildcard has to be expanded here,
+        // but the copies are written in one block and the PDA merges them back into one rule per destination.
+        const std::vector<label_t>* labels = &_labels;
+        if (!_any_top_label[inf->global_id()]) {
+            auto [it, inserted] = _top_label_lists.try_emplace(inf);
+            if (inserted) {
+                _top_labels[inf->global_id()].for_each([&](size_t i) { it->second.push_back(_labels[i]); });
+            }
+            labels = &it->second;
+        }
+        auto wildcard = std::move(rules.back());
         rules.pop_back();
-        for (const auto& label : this->_all_labels) {
-            rules.push_back(cpy);
-            rules.back()._pre = label;
+        auto first = rules.size();
+        rules.insert(rules.end(), labels->size(), wildcard);
+        for (size_t i = 0; i < labels->size(); ++i) {
+            rules[first + i]._pre = (*labels)[i];
         }
     }
 
     template<typename W_FN, typename W>
     std::vector<typename NetworkPDAFactory<W_FN, W>::rule_t> NetworkPDAFactory<W_FN, W>::rules(size_t id) {
-        if (_query.approximation() == Query::EXACT ||
-            _query.approximation() == Query::DUAL) {
-            throw base_error("Exact and Dual analysis method not yet supported");
+        _rule_buffer.clear();
+        append_rules(id, _rule_buffer);
+        return std::vector<rule_t>(_rule_buffer.begin(), _rule_buffer.end());
+    }
+
+    template<typename W_FN, typename W>
+    void NetworkPDAFactory<W_FN, W>::append_rules(size_t id, std::vector<rule_t>& result) {
+        switch (_query.approximation()) {
+            case Query::OVER:
+                mode_rules<Query::OVER>(id, result);
+                break;
+            case Query::UNDER:
+                mode_rules<Query::UNDER>(id, result);
+                break;
+            default:
+                throw base_error("Exact and Dual analysis method not yet supported");
+        }
+    }
+
+    template<typename W_FN, typename W>
+    template<Query::mode_t MODE>
+    void NetworkPDAFactory<W_FN, W>::mode_rules(size_t id, std::vector<rule_t>& result) {
+        if (_budget != nullptr) {
+            _budget->check();
         }
-        nstate_t s;
-        _states.unpack(id, &s);
-        std::vector<typename NetworkPDAFactory<W_FN, W>::rule_t> result;
+        const nstate_t s = _states[id]; // Copy, as adding states may move the stored ones.
+        auto first = result.size();
         if (s._opid < 0) {
             if (s._inf == nullptr)
-                return result;
+                return;
+            _footprint[s._inf->global_id()] = true;
+            auto provenance_first = _provenance.size();
+            const auto& edge_infs = edge_interfaces(s._nfastate);
             // all clean! start pushing.
-            for (auto &entry : s._inf->table().entries()) {
-                for (auto &forward : entry._rules) {
-                    assert(forward._via != nullptr && forward._via->target() != nullptr);
-                    if (forward._via->is_virtual()) {
-                        if (!start_rule(id, s, forward, entry, s._nfastate, result))
+            for (auto &entry : _transitions.entries(s._inf)) {
+                if (!entry._ignores_label && !can_be_top(s._inf, entry._top_label))
+                    continue; // No packet with this label arrives here.
+                for (auto &forward : entry._forwards) {
+                    if (forward._virtual) {
+                        if (!start_rule<MODE>(id, s, forward, entry, s._nfastate, result))
                             continue;
                     } else {
-                        for (auto &e : s._nfastate->_edges) {
-                            if (e.empty(_network.all_interfaces().size())) {
-                                continue;
-                            }
-                            auto lb = std::lower_bound(e._symbols.begin(), e._symbols.end(), forward._via->global_id());
-                            bool found = lb != std::end(e._symbols) && *lb == forward._via->global_id();
-
-                            if (found != (!e._negated)) {
-                                continue;
-                            } else {
-                                if (!start_rule(id, s, forward, entry, e._destination, result))
-                                    continue;
+                        for (size_t ei = 0; ei < edge_infs.size(); ++ei) {
+                            if (edge_infs[ei].test(forward._via_id)) {
+                                start_rule<MODE>(id, s, forward, entry, s._nfastate->_edges[ei]._destination, result);
                             }
                         }
                     }
                 }
             }
+            if (_provenance_range.size() <= id) {
+                _provenance_range.resize(id + 1);
+            }
+            _provenance_range[id] = std::make_pair(provenance_first, _provenance.size());
         } else {
-            auto &r = s._inf->table().entries()[s._eid]._rules[s._rid];
-            result.emplace_back();
-            auto &nr = result.back();
+            auto &entry = _transitions.entries(s._inf)[s._eid];
+            auto &r = entry._forwards[s._rid];
             auto &act = r._ops[s._opid + 1];
-            nr._pre = s._inf->table().entries()[s._eid]._top_label;
-            for (auto pid = 0; pid <= s._opid; ++pid) {
-                switch (r._ops[pid]._op) {
-                    case RoutingTable::op_t::SWAP:
-                    case RoutingTable::op_t::PUSH:
-                        nr._pre = r._ops[pid]._op_label;
-                        break;
-                    case RoutingTable::op_t::POP:
-                    default:
-                        throw base_error("Unexpected pop!");
-                        assert(false);
-                }
-            }
-            switch (act._op) {
-                case RoutingTable::op_t::POP:
-                    nr._op = pdaaal::POP;
-                    throw base_error("Unexpected pop!");
-                    assert(false);
-                    break;
-                case RoutingTable::op_t::PUSH:
-                    nr._op = pdaaal::PUSH;
-                    nr._op_label = act._op_label;
-                    break;
-                case RoutingTable::op_t::SWAP:
-                    nr._op = pdaaal::SWAP;
-                    nr._op_label = act._op_label;
-                    break;
+            if (act._op == pdaaal::POP) {
+                throw base_error("Unexpected pop!");
             }
+            result.emplace_back();
+            auto &nr = result.back();
+            nr._pre = act._pre;
+            nr._op = act._op;
+            nr._op_label = act._op_label;
             //Also handle nr  (Routerhop(Latensy), Network Stack Size, traffic engineergroup failiures) (does the implementaion approache work?) (Define MPLS in report)
             if (s._opid + 2 == (int) r._ops.size()) {
-                auto res = add_state(s._nfastate, r._via->match(), s._appmode);
+                auto res = add_state(s._nfastate, r._target, s._appmode);
                 nr._dest = res.second;
                 if constexpr (is_weighted) {
-                    nr._weight = _weight_f(r, s._inf->table().entries()[s._eid]);
+                    nr._weight = _weight_f(r, entry);
                 }
             } else {
-                auto res = add_state(s._nfastate, s._inf, s._appmode, s._eid, s._rid, s._opid + 1);
-                nr._dest = res.second;
+                nr._dest = id + 1; // The next state in the chain.
             }
             //or/andHere
         }
-        return result;
+        _num_rules += result.size() - first;
     }
 
     template<typename W_FN, typename W>
-    void NetworkPDAFactory<W_FN, W>::print_trace_rule(std::ostream &stream, const Interface* inf,
-                                                  const RoutingTable::entry_t &entry,
-                                                  const RoutingTable::forward_t &rule) const {
-        stream << "{";
-
-        auto name = inf->source()->interface_name(inf->id());
-        stream << R"("ingoing":")" << name << "\"";
-        stream << ",\"pre\":";
-        if (entry.ignores_label()) {
-            stream  << "\"null\"";
-        } else {
-            stream << "\"" << entry._top_label << "\"";
-        }
-        stream << ",\"rule\":";
-        rule.print_json(stream, false);
-
+    json NetworkPDAFactory<W_FN, W>::trace_rule(const Interface* inf, const NetworkTransitions::entry_t &entry,
+                                                const NetworkTransitions::forward_t &rule) const {
+        json result;
+        result["ingoing"] = inf->source()->interface_name(inf->id());
+        result["pre"] = entry._ignores_label ? "null" : std::to_string(entry._top_label);
+        result["rule"] = rule._forward->to_json();
         if constexpr (is_weighted) {
-            stream << ", \"priority-weight\": [";
-            auto weights = _weight_f(rule, entry);
-            for (size_t v = 0; v < weights.size(); v++){
-                if (v != 0) stream << ", ";
-                stream << "\"" << std::to_string(weights[v]) << "\"";
+            auto& weights = result["priority-weight"] = json::array();
+            for (auto weight : _weight_f(rule, entry)) {
+                weights.push_back(std::to_string(weight));
             }
-            stream << "]";
         }
-        stream << "}";
+        return result;
     }
 
     template<typename W_FN, typename W>
     bool NetworkPDAFactory<W_FN, W>::add_interfaces(std::unordered_set<const Interface *> &disabled,
                                                  std::unordered_set<const Interface *> &active,
-                                                 const RoutingTable::entry_t &entry,
-                                                 const RoutingTable::forward_t &fwd) const {
+                                                 const NetworkTransitions::forward_t &fwd) const {
+        ++_concretization_attempts;
         auto *inf = fwd._via;
         if (disabled.count(inf) > 0) {
             return false; // should be down!
@@ -434,132 +763,86 @@ namespace aalwines {
         // these must have been disabled!
         if (fwd._priority == 0)
             return true;
-        std::unordered_set<const Interface *> tmp = disabled;
-
-        // find failing rule and disable _via interface
-        for(auto &rule : entry._rules){
-            if (rule._priority < fwd._priority) {
-                if (active.count(rule._via) > 0) return false;
-                tmp.insert(rule._via);
-                if (tmp.size() > (uint32_t) _query.number_of_failures()) {
-                    return false;
-                }
-                break;
-            }
-        }
-        if (tmp.size() > (uint32_t) _query.number_of_failures()) {
+
+        // disable the _via interface of the failing rule, found when the transitions were compiled
+        const Interface* failed = fwd._must_fail;
+        if (failed != nullptr && active.count(failed) > 0) return false;
+        auto failures = disabled.size() + (failed != nullptr && disabled.count(failed) == 0 ? 1 : 0);
+        if (failures > (uint32_t) _query.number_of_failures()) {
             return false;
-        } else {
-            disabled.swap(tmp);
-            active.insert(fwd._via);
-            return true;
         }
+        if (failed != nullptr) {
+            disabled.insert(failed);
+        }
+        active.insert(fwd._via);
+        return true;
     }
 
     template<typename W_FN, typename W>
-    bool NetworkPDAFactory<W_FN, W>::concreterize_trace(std::ostream &stream, const std::vector<PDA::tracestate_t> &trace,
-                                                     std::vector<const RoutingTable::entry_t *> &entries,
-                                                     std::vector<const RoutingTable::forward_t *> &rules) {
+    bool NetworkPDAFactory<W_FN, W>::concreterize_trace(json &trace_out, const std::vector<PDA::tracestate_t> &trace,
+                                                     std::vector<const NetworkTransitions::entry_t *> &entries,
+                                                     std::vector<const NetworkTransitions::forward_t *> &rules) {
         std::unordered_set<const Interface *> disabled, active;
 
         for (size_t sno = 0; sno < trace.size(); ++sno) {
             auto &step = trace[sno];
             if (step._pdastate > 1 && step._pdastate < this->_num_pda_states) {
                 // handle, lookup right states
-                nstate_t s;
-                _states.unpack(step._pdastate, &s);
+                const auto& s = _states[step._pdastate];
                 if (s._opid >= 0) {
                     // Skip, we are just doing a bunch of ops here, printed elsewhere.
                 } else {
                     if (sno != trace.size() - 1 && trace[sno + 1]._pdastate > 1 &&
                         trace[sno + 1]._pdastate < this->_num_pda_states && !step._stack.empty()) {
                         // peek at next element, we want to write the ops here
-                        nstate_t next;
-                        _states.unpack(trace[sno + 1]._pdastate, &next);
+                        const auto& next = _states[trace[sno + 1]._pdastate];
                         if (next._opid != -1) {
                             // we get the rule we use, print
-                            auto &entry = next._inf->table().entries()[next._eid];
-                            if (!add_interfaces(disabled, active, entry, entry._rules[next._rid])) {
+                            auto &entry = _transitions.entries(next._inf)[next._eid];
+                            if (!add_interfaces(disabled, active, entry._forwards[next._rid])) {
                                 return false;
                             }
-                            rules.push_back(&entry._rules[next._rid]);
+                            rules.push_back(&entry._forwards[next._rid]);
                             entries.push_back(&entry);
                         } else {
-                            // we have to guess which rule we used!
-                            // run through the rules and find a match!
+                            // look up the forwards that the rules from this state to the next were made from.
                             auto &nstep = trace[sno + 1];
                             bool found = false;
-                            for (auto &entry : s._inf->table().entries()) {
-                                if (found) break;
-                                if (entry._top_label != step._stack.front())
-                                    continue; // not matching on pre
-                                for (auto &r : entry._rules) {
-                                    bool ok = false;
-                                    switch (_query.approximation()) {
-                                        case Query::UNDER:
-                                            assert(next._appmode >= s._appmode);
-                                            ok = ((ssize_t) r._priority) == (next._appmode - s._appmode);
+                            auto [begin, end] = step._pdastate < _provenance_range.size() ?
+                                    _provenance_range[step._pdastate] : std::make_pair<size_t, size_t>(0, 0);
+                            for (auto p = begin; p < end && !found; ++p) {
+                                const auto& prov = _provenance[p];
+                                if (prov._dest != nstep._pdastate || (!prov._ignores_label && prov._pre != step._stack.front()))
+                                    continue;
+                                auto &entry = _transitions.entries(s._inf)[prov._eid];
+                                auto &r = *entry._forwards[prov._rid]._forward;
+                                // Several forwards can give the same transition between states, so check the operation.
+                                bool ok = false;
+                                if (r._ops.empty()) {
+                                    ok = nstep._stack.size() == step._stack.size() && nstep._stack.front() == step._stack.front();
+                                } else {
+                                    switch (r._ops[0]._op) {
+                                        case RoutingTable::op_t::SWAP:
+                                            ok = nstep._stack.size() == step._stack.size() && nstep._stack.front() == r._ops[0]._op_label;
                                             break;
-                                        case Query::OVER:
-                                            ok = ((ssize_t) r._priority) <= _query.number_of_failures();
+                                        case RoutingTable::op_t::PUSH:
+                                            ok = nstep._stack.size() == step._stack.size() + 1 && nstep._stack.front() == r._ops[0]._op_label;
+                                            break;
+                                        case RoutingTable::op_t::POP:
+                                            ok = nstep._stack.size() == step._stack.size() - 1;
                                             break;
-                                        case Query::DUAL:
-                                            throw base_error("Tracing for DUAL not yet implemented");
-                                        case Query::EXACT:
-                                            throw base_error("Tracing for EXACT not yet implemented");
-                                    }
-                                    if (ok) { // TODO, fix for approximations here!
-                                        if (r._ops.size() > 1) continue; // would have been handled in other case
-
-                                        if (r._via && r._via->match() == next._inf) {
-                                            if (r._ops.empty() || r._ops[0]._op == RoutingTable::op_t::SWAP) {
-                                                if (step._stack.size() == nstep._stack.size()) {
-                                                    if (!r._ops.empty()) {
-                                                        assert(r._ops[0]._op == RoutingTable::op_t::SWAP);
-                                                        if (nstep._stack.front() != r._ops[0]._op_label)
-                                                            continue;
-                                                    } else if (entry._top_label != nstep._stack.front()) {
-                                                        continue;
-                                                    }
-                                                    if (!add_interfaces(disabled, active, entry, r))
-                                                        continue;
-                                                    rules.push_back(&r);
-                                                    entries.push_back(&entry);
-                                                    found = true;
-                                                    break;
-                                                }
-                                            } else {
-                                                assert(r._ops.size() == 1);
-                                                assert(r._ops[0]._op == RoutingTable::op_t::PUSH ||
-                                                       r._ops[0]._op == RoutingTable::op_t::POP);
-                                                if (r._ops[0]._op == RoutingTable::op_t::POP &&
-                                                    nstep._stack.size() == step._stack.size() - 1) {
-                                                    if (!add_interfaces(disabled, active, entry, r))
-                                                        continue;
-                                                    rules.push_back(&r);
-                                                    entries.push_back(&entry);
-                                                    found = true;
-                                                    break;
-                                                } else if (r._ops[0]._op == RoutingTable::op_t::PUSH &&
-                                                           nstep._stack.size() == step._stack.size() + 1 &&
-                                                           r._ops[0]._op_label == nstep._stack.front()) {
-                                                    if (!add_interfaces(disabled, active, entry, r))
-                                                        continue;
-
-                                                    rules.push_back(&r);
-                                                    entries.push_back(&entry);
-                                                    found = true;
-                                                    break;
-                                                }
-                                            }
-                                        }
                                     }
                                 }
+                                if (!ok || !add_interfaces(disabled, active, entry._forwards[prov._rid]))
+                                    continue;
+                                rules.push_back(&entry._forwards[prov._rid]);
+                                entries.push_back(&entry);
+                                found = true;
                             }
 
                             // check if we violate the soundness of the network
                             if (!found) {
-                                stream << "{\"pre\":\"error\"}";
+                                trace_out.push_back(json{{"pre", "error"}});
                                 return false;
                             }
                         }
@@ -575,21 +858,16 @@ namespace aalwines {
 
     template<typename W_FN, typename W>
     void
-    NetworkPDAFactory<W_FN, W>::write_concrete_trace(std::ostream &stream, const std::vector<PDA::tracestate_t> &trace,
-                                                  std::vector<const RoutingTable::entry_t *> &entries,
-                                                  std::vector<const RoutingTable::forward_t *> &rules) {
-        bool first = true;
+    NetworkPDAFactory<W_FN, W>::write_concrete_trace(json &trace_out, const std::vector<PDA::tracestate_t> &trace,
+                                                  std::vector<const NetworkTransitions::entry_t *> &entries,
+                                                  std::vector<const NetworkTransitions::forward_t *> &rules) {
         size_t cnt = 0;
         for (const auto &step : trace) {
             if (step._pdastate > 1 && step._pdastate < this->_num_pda_states) {
-                nstate_t s;
-                _states.unpack(step._pdastate, &s);
+                const auto& s = _states[step._pdastate];
                 if (s._opid >= 0) {
                     // Skip, we are just doing a bunch of ops here, printed elsewhere.
                 } else {
-                    if (!first)
-                        stream << ",\n";
-                    stream << "\t\t\t{";
                     assert(s._inf != nullptr);
                     auto from_inf = s._inf->match();
                     auto from_router = s._inf->target();
@@ -598,48 +876,49 @@ namespace aalwines {
                     assert(from_inf != nullptr);
                     assert(from_router != nullptr);
                     assert(to_router != nullptr);
-                    stream << R"("from_router":")" << from_router->name() << "\""
-                           << R"(,"from_interface":")" << from_router->interface_name(from_inf->id()) << "\""
-                           << R"(,"to_router":")" << to_router->name() << "\""
-                           << R"(,"to_interface":")" << to_router->interface_name(to_inf->id()) << "\"";
-                    stream << ",\"stack\":[";
-                    bool first_symbol = true;
+                    json stack = json::array();
                     for (auto &symbol : step._stack) {
                         if (symbol == Query::bottom_of_stack()) continue;
-                        if (!first_symbol) stream << ",";
-                        stream << "\"" << symbol;
-                        //if (_network.is_service_label(symbol))
-                        //    stream << "^";
-                        stream << "\"";
-                        first_symbol = false;
+                        stack.push_back(std::to_string(symbol));
                     }
-                    stream << "]}";
+                    trace_out.push_back(json{
+                        {"from_router", from_router->name()},
+                        {"from_interface", from_router->interface_name(from_inf->id())},
+                        {"to_router", to_router->name()},
+                        {"to_interface", to_router->interface_name(to_inf->id())},
+                        {"stack", std::move(stack)}
+                    });
                     if (cnt < entries.size()) {
-                        stream << ",\n\t\t\t";
-                        print_trace_rule(stream, s._inf, *entries[cnt], *rules[cnt]);
+                        trace_out.push_back(trace_rule(s._inf, *entries[cnt], *rules[cnt]));
                         ++cnt;
                     }
-                    first = false;
                 }
             }
         }
     }
 
     template<typename W_FN, typename W>
-    bool NetworkPDAFactory<W_FN, W>::write_json_trace(std::ostream &stream, std::vector<PDA::tracestate_t> &trace) {
+    bool NetworkPDAFactory<W_FN, W>::write_json_trace(json &trace_out, std::vector<PDA::tracestate_t> &trace) {
 
-        std::vector<const RoutingTable::entry_t *> entries;
-        std::vector<const RoutingTable::forward_t *> rules;
+        std::vector<const NetworkTransitions::entry_t *> entries;
+        std::vector<const NetworkTransitions::forward_t *> rules;
 
-        if (!concreterize_trace(stream, trace, entries, rules)) {
+        if (!concreterize_trace(trace_out, trace, entries, rules)) {
             return false;
         }
 
-        // Do the printing
-        write_concrete_trace(stream, trace, entries, rules);
+        write_concrete_trace(trace_out, trace, entries, rules);
         return true;
     }
 
+    template<typename W_FN, typename W>
+    bool NetworkPDAFactory<W_FN, W>::write_json_trace(std::ostream &stream, std::vector<PDA::tracestate_t> &trace) {
+        auto trace_out = json::array();
+        auto res = write_json_trace(trace_out, trace);
+        stream << trace_out.dump();
+        return res;
+    }
+
     template<typename W_FN, typename W>
     std::function<void(std::ostream &, const Query::label_t &)> NetworkPDAFactory<W_FN, W>::label_writer() const {
         return [](std::ostream &s, const Query::label_t &label) {
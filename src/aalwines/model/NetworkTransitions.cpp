@@ -0,0 +1,132 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   NetworkTransitions.cpp
+ */
+
+#include "NetworkTransitions.h"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+
+namespace aalwines {
+
+    NetworkTransitions::NetworkTransitions(const Network& network) {
+        const auto& interfaces = network.all_interfaces();
+        _table_of.resize(interfaces.size());
+        std::unordered_map<const RoutingTable*, size_t> table_ids;
+        for (const Interface* inf : interfaces) {
+            auto [it, inserted] = table_ids.try_emplace(&inf->table(), _tables.size());
+            _table_of[inf->global_id()] = it->second;
+            if (!inserted) continue;
+            auto& entries = _tables.emplace_back();
+            entries.reserve(inf->table().entries().size());
+            for (const auto& entry : inf->table().entries()) {
+                auto& e = entries.emplace_back();
+                e._entry = &entry;
+                e._top_label = entry._top_label;
+                e._ignores_label = entry.ignores_label();
+                e._forwards.reserve(entry._rules.size());
+                for (const auto& forward : entry._rules) {
+                    e._forwards.push_back(make_forward(entry, forward));
+                }
+                make_groups(e);
+            }
+        }
+    }
+
+    void NetworkTransitions::make_groups(entry_t& entry) {
+        for (const auto& forward : entry._forwards) {
+            entry._groups.push_back(group_t{forward._priority});
+        }
+        std::sort(entry._groups.begin(), entry._groups.end(), [](const group_t& a, const group_t& b) { return a._priority < b._priority; });
+        entry._groups.erase(std::unique(entry._groups.begin(), entry._groups.end(),
+                                        [](const group_t& a, const group_t& b) { return a._priority == b._priority; }), entry._groups.end());
+        // The failures of a group are the distinct via interfaces of all lower groups.
+        std::vector<const Interface*> failed;
+        size_t next = 0;
+        for (auto& group : entry._groups) {
+            for (const auto& forward : entry._forwards) {
+                if (forward._priority < group._priority && forward._priority >= next) {
+                    failed.push_back(forward._via);
+                }
+            }
+            std::sort(failed.begin(), failed.end());
+            failed.erase(std::unique(failed.begin(), failed.end()), failed.end());
+            group._failures = static_cast<uint32_t>(failed.size());
+            next = group._priority;
+        }
+        for (auto& forward : entry._forwards) {
+            forward._group = std::lower_bound(entry._groups.begin(), entry._groups.end(), forward._priority,
+                                              [](const group_t& g, size_t priority) { return g._priority < priority; }) - entry._groups.begin();
+            for (const auto& other : entry._forwards) {
+                if (other._priority < forward._priority) {
+                    forward._must_fail = other._via;
+                    break;
+                }
+            }
+        }
+    }
+
+    NetworkTransitions::forward_t NetworkTransitions::make_forward(const RoutingTable::entry_t& entry, const RoutingTable::forward_t& forward) {
+        assert(forward._via != nullptr && forward._via->target() != nullptr);
+        forward_t result;
+        result._forward = &forward;
+        result._via = forward._via;
+        result._target = forward._via->match();
+        result._via_id = forward._via->global_id();
+        result._virtual = forward._via->is_virtual();
+        result._priority = forward._priority;
+
+        if (forward._ops.empty()) {
+            // No operations still needs a transition. Swap to the same label (or do nothing for the label-ignoring entry).
+            auto& op = result._ops.emplace_back();
+            op._pre = entry._top_label;
+            if (!entry.ignores_label()) {
+                op._op = pdaaal::SWAP;
+                op._op_label = entry._top_label;
+            }
+            return result;
+        }
+        label_t pre = entry._top_label;
+        bool popped = false;
+        for (const auto& action : forward._ops) {
+            auto& op = result._ops.emplace_back();
+            op._pre = pre;
+            switch (action._op) {
+                case RoutingTable::op_t::POP:
+                    op._op = pdaaal::POP;
+                    popped = true;
+                    break;
+                case RoutingTable::op_t::PUSH:
+                    op._op = pdaaal::PUSH;
+                    op._op_label = action._op_label;
+                    break;
+                case RoutingTable::op_t::SWAP:
+                    op._op = pdaaal::SWAP;
+                    op._op_label = action._op_label;
+                    break;
+            }
+            if (popped) {
+                op._op = pdaaal::POP; // Anything after a pop is not supported (see above).
+            }
+            pre = action._op_label;
+        }
+        return result;
+    }
+
+}
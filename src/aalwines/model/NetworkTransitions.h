@@ -0,0 +1,100 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   NetworkTransitions.h
+ *
+ * The query-independent part of the network PDA: for each interface, the PDA operations that each of its
+ * forwarding rules is compiled into. It is built once per network and shared by the NetworkPDAFactory of every
+ * query, which then only has to take the product with the query's path NFA.
+ * Entries and forwarding rules have the same indices as in the routing tables they are built from.
+ * Interfaces that share a routing table also share its entries here, so each table is compiled once.
+ */
+
+#ifndef AALWINES_NETWORKTRANSITIONS_H
+#define AALWINES_NETWORKTRANSITIONS_H
+
+#include "Network.h"
+#include <aalwines/utils/small_vector.h>
+#include <pdaaal/TypedPDA.h>
+#include <vector>
+
+namespace aalwines {
+
+    class NetworkTransitions {
+    public:
+        using label_t = Query::label_t;
+
+        struct op_t {
+            pdaaal::op_t _op = pdaaal::NOOP;
+            label_t _op_label = 0;
+            label_t _pre = 0; // Top of stack before this operation. Not used for the first operation of a rule.
+        };
+
+        struct forward_t {
+            const RoutingTable::forward_t* _forward = nullptr;
+            const Interface* _via = nullptr;
+            const Interface* _target = nullptr; // _via->match(), i.e. the interface the packet arrives on.
+            size_t _via_id = 0;
+            bool _virtual = false;
+            size_t _priority = 0;
+            size_t _group = 0; // Index of the priority group of this forward in entry_t::_groups.
+            // The interface of the first lower-priority rule of the entry, which must have failed for this forward to be used.
+            const Interface* _must_fail = nullptr;
+            // One PDA operation per step of the rule. _ops[0] is applied in the rule's first transition,
+            // and _ops[i+1] from the intermediate state with _opid == i. A POP after the first step is not
+            // supported, and is kept here as POP so the factory can report it if it is ever reached.
+            utils::small_vector<op_t, 2> _ops;
+        };
+
+        // The rules of an entry with the same priority (traffic engineering group).
+        struct group_t {
+            size_t _priority = 0;
+            uint32_t _failures = 0; // Distinct via interfaces of the rules in the lower groups, which must all have failed.
+        };
+
+        struct entry_t {
+            const RoutingTable::entry_t* _entry = nullptr;
+            label_t _top_label = 0;
+            bool _ignores_label = false;
+            std::vector<forward_t> _forwards; // In the order of RoutingTable::entry_t::_rules.
+            std::vector<group_t> _groups; // Sorted by priority.
+
+            [[nodiscard]] uint32_t failures_before(const forward_t& forward) const {
+                return _groups[forward._group]._failures;
+            }
+        };
+
+        explicit NetworkTransitions(const Network& network);
+
+        [[nodiscard]] const std::vector<entry_t>& entries(const Interface* inf) const {
+            return _tables[_table_of[inf->global_id()]];
+        }
+
+        [[nodiscard]] size_t number_of_tables() const {
+            return _tables.size();
+        }
+
+    private:
+        static forward_t make_forward(const RoutingTable::entry_t& entry, const RoutingTable::forward_t& forward);
+        static void make_groups(entry_t& entry);
+
+        std::vector<std::vector<entry_t>> _tables; // One for each distinct routing table.
+        std::vector<size_t> _table_of; // Index in _tables, indexed by global interface id.
+    };
+
+}
+
+#endif //AALWINES_NETWORKTRANSITIONS_H
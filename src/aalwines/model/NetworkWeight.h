@@ -27,6 +27,7 @@
 #ifndef AALWINES_NETWORKWEIGHT_H
 #define AALWINES_NETWORKWEIGHT_H
 
+#include "NetworkTransitions.h"
 #include <pdaaal/Weight.h>
 #include <json.hpp>
 
@@ -52,10 +53,10 @@ namespace aalwines {
      */
     class NetworkWeight {
     private:
-        using atomic_property_function = std::function<uint32_t(const RoutingTable::forward_t&, const RoutingTable::entry_t&)>;
-        using linear_weight_function = pdaaal::linear_weight_function<uint32_t, const RoutingTable::forward_t&, const RoutingTable::entry_t&>;
+        using atomic_property_function = std::function<uint32_t(const NetworkTransitions::forward_t&, const NetworkTransitions::entry_t&)>;
+        using linear_weight_function = pdaaal::linear_weight_function<uint32_t, const NetworkTransitions::forward_t&, const NetworkTransitions::entry_t&>;
     public:
-        using weight_function = pdaaal::ordered_weight_function<uint32_t, const RoutingTable::forward_t&, const RoutingTable::entry_t&>;
+        using weight_function = pdaaal::ordered_weight_function<uint32_t, const NetworkTransitions::forward_t&, const NetworkTransitions::entry_t&>;
 
         enum class AtomicProperty {
             default_weight_function,
@@ -75,52 +76,46 @@ namespace aalwines {
         [[nodiscard]] atomic_property_function get_atom(AtomicProperty atom) const {
             switch (atom) {
                 case AtomicProperty::number_of_links:
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
                         return 1;
                     };
                 case AtomicProperty::number_of_hops: // Does not count links that are self-loops.
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
                         return !r._via->is_virtual() ? 1 : 0;
                     };
                 case AtomicProperty::distance:
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
                         return r._via->source()->coordinate() && r._via->target()->coordinate()
                                ? r._via->source()->coordinate()->distance_to(r._via->target()->coordinate().value())
                                : 20038; //(km). If coordinates are missing, use half circumference of earth, i.e. worst case distance.
                     };
                 case AtomicProperty::local_failures:
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& e) -> uint32_t {
-                        std::unordered_set<const Interface*> edges;
-                        for (const auto& other : e._rules) {
-                            if (other._priority < r._priority) {
-                                edges.emplace(other._via);
-                            }
-                        }
-                        return edges.size();
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& e) -> uint32_t {
+                        return e.failures_before(r);
                     };
                 case AtomicProperty::tunnels:
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
-                        auto push_ops = std::count_if(r._ops.begin(), r._ops.end(), [](RoutingTable::action_t act) -> bool { return act._op == RoutingTable::op_t::PUSH; });
-                        auto pop_ops = std::count_if(r._ops.begin(), r._ops.end(), [](RoutingTable::action_t act) -> bool { return act._op == RoutingTable::op_t::POP; });
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
+                        auto push_ops = std::count_if(r._forward->_ops.begin(), r._forward->_ops.end(), [](RoutingTable::action_t act) -> bool { return act._op == RoutingTable::op_t::PUSH; });
+                        auto pop_ops = std::count_if(r._forward->_ops.begin(), r._forward->_ops.end(), [](RoutingTable::action_t act) -> bool { return act._op == RoutingTable::op_t::POP; });
                         return push_ops > pop_ops ? push_ops - pop_ops : 0;
                     };
                 case AtomicProperty::push_ops:
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
-                        return std::count_if(r._ops.begin(), r._ops.end(), [](RoutingTable::action_t act) -> bool { return act._op == RoutingTable::op_t::PUSH; });
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
+                        return std::count_if(r._forward->_ops.begin(), r._forward->_ops.end(), [](RoutingTable::action_t act) -> bool { return act._op == RoutingTable::op_t::PUSH; });
                     };
                 case AtomicProperty::custom:
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
-                        return r._weight;
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
+                        return r._forward->_weight;
                     };
 /*                case AtomicProperty::latency:
-                    return [this](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
+                    return [this](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
                         auto it = this->_latency_map.find(r._via);
                         return it != this->_latency_map.end() ? it->second : 0;
                         // (r._via->source()->index(), r._via->target()->index())
                     };*/
                 case AtomicProperty::default_weight_function:
                 default:
-                    return [](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
+                    return [](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
                         return 0;
                     };
             }
@@ -145,7 +140,7 @@ namespace aalwines {
         }
 
         static auto default_weight_fn() {
-            return pdaaal::ordered_weight_function(std::vector<linear_weight_function>{linear_weight_function{[](const RoutingTable::forward_t& r, const RoutingTable::entry_t& _) -> uint32_t {
+            return pdaaal::ordered_weight_function(std::vector<linear_weight_function>{linear_weight_function{[](const NetworkTransitions::forward_t& r, const NetworkTransitions::entry_t& _) -> uint32_t {
                 return 0;
             }}});
         }
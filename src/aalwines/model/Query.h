@@ -30,6 +30,7 @@
 #include "aalwines/utils/errors.h"
 
 #include <functional>
+#include <optional>
 #include <ostream>
 #include <ptrie/ptrie.h>
 
@@ -78,12 +79,26 @@ namespace aalwines {
         [[nodiscard]] int number_of_failures() const {
             return _link_failures;
         }
+        void set_number_of_failures(int lf) {
+            _link_failures = lf;
+        }
+
+        // A query with a range of failure bounds (written "0..3") is verified with increasing bounds,
+        // until it is satisfied or the upper bound is reached.
+        void set_failure_range(int from, int to) {
+            _failure_range = std::make_pair(from, to);
+            _link_failures = from;
+        }
+        [[nodiscard]] const std::optional<std::pair<int,int>>& failure_range() const {
+            return _failure_range;
+        }
         void print_dot(std::ostream& out);
     private:
         pdaaal::NFA<label_t> _prestack;
         pdaaal::NFA<label_t> _poststack;
         pdaaal::NFA<label_t> _path;
         int _link_failures = 0;
+        std::optional<std::pair<int,int>> _failure_range;
         mode_t _mode;
     };
 }
@@ -28,10 +28,12 @@
 #include "Network.h"
 #include "aalwines/utils/errors.h"
 
+#include <algorithm>
 #include <vector>
 #include <streambuf>
 #include <sstream>
 #include <set>
+#include <unordered_map>
 #include <cassert>
 
 namespace aalwines {
@@ -52,7 +54,14 @@ namespace aalwines {
             _interface_map[interface->get_name()] = new_interface;
             new_interface->_parent = this;
         }
+        // Interfaces that shared a table in the original router share the updated copy.
+        std::unordered_map<const RoutingTable*, const Interface*> copied_tables;
         for (auto& interface : _interfaces) {
+            auto [it, inserted] = copied_tables.try_emplace(&std::as_const(*interface).table(), interface.get());
+            if (!inserted) {
+                interface->share_table(*it->second);
+                continue;
+            }
             interface->table().update_interfaces([this](const Interface* old) -> Interface* {
                 return old == nullptr ? nullptr : this->_interfaces[old->id()].get();
             });
@@ -60,6 +69,22 @@ namespace aalwines {
         return *this;
     }
 
+    void Router::share_identical_tables() {
+        std::unordered_map<size_t, std::vector<const Interface*>> tables; // Interfaces with distinct tables, by content hash.
+        for (auto& interface : _interfaces) {
+            const auto& table = std::as_const(*interface).table();
+            auto& candidates = tables[table.content_hash()];
+            auto it = std::find_if(candidates.begin(), candidates.end(), [&table](const Interface* other) {
+                return &other->table() == &table || other->table().same_content(table);
+            });
+            if (it == candidates.end()) {
+                candidates.push_back(interface.get());
+            } else {
+                interface->share_table(**it);
+            }
+        }
+    }
+
     void Router::add_name(const std::string& name) {
         _names.emplace_back(name);
     }
@@ -134,7 +159,7 @@ namespace aalwines {
         for(auto& i : _interfaces) {
             auto name = interface_name(i->id());
             s << "\tinterface: \"" << name << "\"\n";
-            const RoutingTable& table = i->table();
+            const RoutingTable& table = std::as_const(*i).table();
             for(auto& e : table.entries()) {
                 s << "\t\t[" << e._top_label << "] {\n";
                 for(auto& fwd : e._rules) {
@@ -169,7 +194,7 @@ namespace aalwines {
             if_name = interface_name(i->id());
             auto& label_set = interfaces.try_emplace(if_name).first->second;
 
-            const RoutingTable& table = i->table();
+            const RoutingTable& table = std::as_const(*i).table();
             for(auto& e : table.entries()) {
                 label_set.emplace(e._top_label);
                 for(auto& fwd : e._rules) {
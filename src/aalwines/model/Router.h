@@ -62,12 +62,21 @@ namespace aalwines {
             return _parent;
         }
 
+        // Interfaces with identical routing tables (e.g. the names of one interface) can share one table.
+        // A shared table is copied on the first access through the non-const table(), so read through a const Interface.
         RoutingTable& table() {
-            return _table;
+            if (_table.use_count() > 1) {
+                _table = std::make_shared<RoutingTable>(*_table);
+            }
+            return *_table;
         }
 
         [[nodiscard]] const RoutingTable& table() const {
-            return _table;
+            return *_table;
+        }
+
+        void share_table(const Interface& other) {
+            _table = other._table;
         }
 
         [[nodiscard]] bool is_virtual() const {
@@ -92,7 +101,7 @@ namespace aalwines {
         Router* _target = nullptr;
         Router* _parent = nullptr;
         Interface* _matching = nullptr;
-        RoutingTable _table;
+        std::shared_ptr<RoutingTable> _table = std::make_shared<RoutingTable>();
     };
 
     class Router {
@@ -134,6 +143,8 @@ namespace aalwines {
         Interface* get_interface(const std::string& interface_name, std::vector<const Interface*>& all_interfaces);
         Interface* find_interface(const std::string& interface_name);
         [[nodiscard]] std::string interface_name(size_t i) const;
+        // Lets interfaces whose routing tables have the same content share one table.
+        void share_identical_tables();
 
         void print_simple(std::ostream& s) const;
         void print_json(json_stream& json_output) const;
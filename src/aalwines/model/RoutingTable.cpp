@@ -41,12 +41,30 @@ namespace aalwines
         assert(std::is_sorted(_entries.begin(), _entries.end()));
         entry_t entry;
         entry._top_label = top_label;
+        if (_entries.empty() || _entries.back() < entry) {
+            // Adding labels in increasing order only appends, so building a table that way is linear.
+            if (_indexed) _label_index.emplace(top_label, _entries.size());
+            _entries.push_back(entry);
+            return std::prev(_entries.end());
+        }
         auto lb = std::lower_bound(_entries.begin(), _entries.end(), entry);
         if (lb == std::end(_entries) || (*lb) != entry) {
+            clear_index();
             lb = _entries.insert(lb, entry);
         }
         return lb;
     }
+    std::vector<RoutingTable::entry_t>::iterator RoutingTable::find_entry(label_t top_label) {
+        if (!_indexed) {
+            _label_index.reserve(_entries.size());
+            for (size_t i = 0; i < _entries.size(); ++i) {
+                _label_index.emplace(_entries[i]._top_label, i); // Keeps the first if a label is repeated.
+            }
+            _indexed = true;
+        }
+        auto it = _label_index.find(top_label);
+        return it == _label_index.end() ? _entries.end() : _entries.begin() + it->second;
+    }
     void RoutingTable::add_rules(label_t top_label, const std::vector<forward_t>& rules) {
         auto it = insert_entry(top_label);
         it->_rules.insert(it->_rules.end(), rules.begin(), rules.end());
@@ -117,29 +135,14 @@ namespace aalwines
     void RoutingTable::merge(const RoutingTable& other) {
         assert(std::is_sorted(other._entries.begin(), other._entries.end()));
         assert(std::is_sorted(_entries.begin(), _entries.end()));
+        clear_index();
         auto iit = _entries.begin();
         for (const auto & e : other._entries) {
             while (iit != std::end(_entries) && (*iit) < e) ++iit;
             if (iit == std::end(_entries)) {
                 iit = _entries.insert(iit, e);
             } else if ((*iit) == e) {
-                bool legal_merge = true;
-                for (const auto& rule : e._rules) { // TODO: Consider sorted rules for faster merge.
-                    // Already exists
-                    if (std::find(iit->_rules.begin(), iit->_rules.end(), rule) != iit->_rules.end()) continue;
-                    // Different traffic engineering group
-                    if (std::find_if(iit->_rules.begin(), iit->_rules.end(),
-                                     [w = rule._priority](const forward_t& r){ return r._priority == w; })
-                        == iit->_rules.end()) {
-                        iit->_rules.push_back(rule);
-                    } else {
-                        legal_merge = false;
-                        break;
-                    }
-                }
-                if (legal_merge) continue;
-                assert(false); // TODO: Figure out what to do here!
-                iit->_rules.insert(iit->_rules.end(), e._rules.begin(), e._rules.end());
+                merge_rules(*iit, e);
             } else {
                 assert(e < (*iit));
                 iit = _entries.insert(iit, e);
@@ -148,6 +151,52 @@ namespace aalwines
         assert(std::is_sorted(_entries.begin(), _entries.end()));
     }
 
+    void RoutingTable::merge_rules(entry_t& entry, const entry_t& other) {
+        // Visit the rules of both entries in canonical order, so a single pass finds the duplicates and the priority clashes.
+        auto canonical_order = [](const std::vector<forward_t>& rules) {
+            std::vector<size_t> order(rules.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&rules](size_t a, size_t b){ return rules[a] < rules[b]; });
+            return order;
+        };
+        auto illegal_merge = [&entry](size_t priority) {
+            std::stringstream es;
+            es << "error: Cannot merge routing tables, the entry for label ";
+            if (entry.ignores_label()) es << "null"; else entry_t::print_label(entry._top_label, es, false);
+            es << " would get different rules with priority " << priority << "." << std::endl;
+            return base_error(es.str());
+        };
+        const auto& rules = entry._rules;
+        const auto& other_rules = other._rules;
+        auto order = canonical_order(rules);
+        auto other_order = canonical_order(other_rules);
+        std::vector<size_t> added; // Indices into other_rules.
+        size_t i = 0;
+        for (size_t j = 0; j < other_order.size();) {
+            auto priority = other_rules[other_order[j]]._priority;
+            while (i < order.size() && rules[order[i]]._priority < priority) ++i;
+            if (i < order.size() && rules[order[i]]._priority == priority) {
+                // Existing traffic engineering group: Every rule must already be there.
+                for (; j < other_order.size() && other_rules[other_order[j]]._priority == priority; ++j) {
+                    const auto& rule = other_rules[other_order[j]];
+                    while (i < order.size() && rules[order[i]] < rule) ++i;
+                    if (i == order.size() || rules[order[i]] != rule) throw illegal_merge(priority);
+                }
+            } else {
+                // New traffic engineering group: Add it, if it consists of a single (possibly repeated) rule.
+                const auto& rule = other_rules[other_order[j]];
+                added.push_back(other_order[j]);
+                for (++j; j < other_order.size() && other_rules[other_order[j]]._priority == priority; ++j) {
+                    if (other_rules[other_order[j]] != rule) throw illegal_merge(priority);
+                }
+            }
+        }
+        // Nothing is changed before the merge is known to be legal, and new rules keep their relative order.
+        std::sort(added.begin(), added.end());
+        entry._rules.reserve(rules.size() + added.size());
+        for (auto id : added) entry._rules.push_back(other_rules[id]);
+    }
+
     bool RoutingTable::entry_t::operator<(const entry_t& other) const
     {
         return _top_label < other._top_label;
@@ -168,12 +217,20 @@ namespace aalwines
     bool RoutingTable::forward_t::operator!=(const forward_t& other) const {
         return !(*this == other);
     }
+    bool RoutingTable::forward_t::operator<(const forward_t& other) const {
+        if (_priority != other._priority) return _priority < other._priority;
+        if (_via != other._via) return std::less<Interface*>()(_via, other._via);
+        return std::lexicographical_compare(_ops.begin(), _ops.end(), other._ops.begin(), other._ops.end());
+    }
     bool RoutingTable::action_t::operator==(const action_t& other) const {
         return _op == other._op && _op_label == other._op_label;
     }
     bool RoutingTable::action_t::operator!=(const action_t& other) const {
         return !(*this == other);
     }
+    bool RoutingTable::action_t::operator<(const action_t& other) const {
+        return _op != other._op ? _op < other._op : _op_label < other._op_label;
+    }
 
     void RoutingTable::action_t::print_json(std::ostream& s, bool quote, bool use_hex, const Network* network) const
     {
@@ -216,6 +273,19 @@ namespace aalwines
         }
     }
 
+    nlohmann::json RoutingTable::action_t::to_json() const
+    {
+        switch (_op) {
+        case op_t::SWAP:
+            return nlohmann::json{{"swap", std::to_string(_op_label)}};
+        case op_t::PUSH:
+            return nlohmann::json{{"push", std::to_string(_op_label)}};
+        case op_t::POP:
+        default:
+            return "pop";
+        }
+    }
+
     void RoutingTable::entry_t::print_json(std::ostream& s) const
     {
         if (ignores_label()) {
@@ -267,6 +337,24 @@ namespace aalwines
         s << "}";
     }
 
+    nlohmann::json RoutingTable::forward_t::to_json() const
+    {
+        nlohmann::json result;
+        result["weight"] = _priority;
+        if (_via) {
+            result["via"] = _via->get_name();
+        } else {
+            result["drop"] = true;
+        }
+        if (!_ops.empty()) {
+            auto& ops = result["ops"] = nlohmann::json::array();
+            for (const auto& op : _ops) {
+                ops.push_back(op.to_json());
+            }
+        }
+        return result;
+    }
+
     void RoutingTable::print_json(std::ostream& s) const
     {
         s << "\t{\n";
@@ -279,8 +367,29 @@ namespace aalwines
         s << "\n\t}";
     }
 
+    void RoutingTable::replace_rules(label_t top_label, std::vector<forward_t> rules) {
+        // Tables are not necessarily sorted here (e.g. directly after parsing), so look up in the label index.
+        auto it = find_entry(top_label);
+        if (it == _entries.end()) {
+            _label_index.emplace(top_label, _entries.size());
+            it = _entries.emplace(_entries.end(), top_label);
+        }
+        it->_rules = std::move(rules);
+    }
+
+    bool RoutingTable::remove_entry(label_t top_label) {
+        auto it = find_entry(top_label);
+        if (it == _entries.end()) {
+            return false;
+        }
+        clear_index();
+        _entries.erase(it);
+        return true;
+    }
+
     void RoutingTable::sort()
     {
+        clear_index();
         std::sort(std::begin(_entries), std::end(_entries));
     }
 
@@ -294,6 +403,38 @@ namespace aalwines
         return _entries;
     }
 
+    size_t RoutingTable::content_hash() const
+    {
+        size_t hash = _entries.size();
+        auto combine = [&hash](size_t value) {
+            hash ^= std::hash<size_t>()(value) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        };
+        for (const auto& entry : _entries) {
+            combine(entry._top_label);
+            combine(entry._rules.size());
+            for (const auto& rule : entry._rules) {
+                combine(reinterpret_cast<uintptr_t>(rule._via));
+                combine(rule._priority);
+                combine(rule._weight);
+                for (const auto& op : rule._ops) {
+                    combine(static_cast<size_t>(op._op));
+                    combine(op._op_label);
+                }
+            }
+        }
+        return hash;
+    }
+
+    bool RoutingTable::same_content(const RoutingTable& other) const
+    {
+        return std::equal(_entries.begin(), _entries.end(), other._entries.begin(), other._entries.end(),
+                          [](const entry_t& a, const entry_t& b) {
+            return a._top_label == b._top_label
+                && std::equal(a._rules.begin(), a._rules.end(), b._rules.begin(), b._rules.end(),
+                              [](const forward_t& r, const forward_t& s) { return r == s && r._weight == s._weight; });
+        });
+    }
+
     std::ostream& operator<<(std::ostream& s, const RoutingTable::forward_t& fwd)
     {
         fwd.print_json(s);
@@ -30,8 +30,11 @@
 #include <utility>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include <ptrie/ptrie_map.h>
+#include <json.hpp>
+#include <aalwines/utils/small_vector.h>
 
 #include "Query.h"
 
@@ -62,22 +65,30 @@ namespace aalwines {
                 _op_label = static_cast<size_t>(std::stoul(op_label));
             };
             void print_json(std::ostream& s, bool quote = true, bool use_hex = true, const Network* network = nullptr) const;
+            // Same as print_json without hex labels, e.g. {"swap": "42"} or "pop".
+            [[nodiscard]] nlohmann::json to_json() const;
             bool operator==(const action_t& other) const;
             bool operator!=(const action_t& other) const;
+            bool operator<(const action_t& other) const;
         };
 
         struct forward_t {
-            std::vector<action_t> _ops;
+            using ops_t = utils::small_vector<action_t, 2>; // Rules almost always have at most two operations.
+            ops_t _ops;
             Interface* _via = nullptr;
             size_t _priority = 0;
             uint32_t _weight = 0;
             forward_t() = default;
-            forward_t(std::vector<action_t> ops, Interface* via, size_t priority, uint32_t weight = 0)
+            forward_t(ops_t ops, Interface* via, size_t priority, uint32_t weight = 0)
                 : _ops(std::move(ops)), _via(via), _priority(priority), _weight(weight) {};
             void print_json(std::ostream&, bool use_hex = true, const Network* network = nullptr) const;
+            // Same as print_json with the via interface by name, as used in traces.
+            [[nodiscard]] nlohmann::json to_json() const;
             friend std::ostream& operator<<(std::ostream& s, const forward_t& fwd);
             bool operator==(const forward_t& other) const;
             bool operator!=(const forward_t& other) const;
+            // Canonical order of the rules of an entry: by priority, then via, then ops. Consistent with ==.
+            bool operator<(const forward_t& other) const;
             void add_action(action_t action);
         };
 
@@ -110,12 +121,16 @@ namespace aalwines {
         void print_json(std::ostream&) const;
 
         [[nodiscard]] const std::vector<entry_t>& entries() const;
+        // Hash and comparison of the entries and all their rules in order, i.e. whether two tables route the same way.
+        [[nodiscard]] size_t content_hash() const;
+        [[nodiscard]] bool same_content(const RoutingTable& other) const;
         
         void sort();
+        // Entries are appended as they are (e.g. while parsing); call sort() once afterwards if the table must be sorted.
         template <typename... Args>
-        entry_t& emplace_entry(Args... args) { return _entries.emplace_back(std::forward<Args>(args)...); }
-        void pop_entry() { _entries.pop_back(); }
-        entry_t& back() { return _entries.back(); }
+        entry_t& emplace_entry(Args... args) { clear_index(); return _entries.emplace_back(std::forward<Args>(args)...); }
+        void pop_entry() { clear_index(); _entries.pop_back(); }
+        entry_t& back() { clear_index(); return _entries.back(); }
 
         void add_rules(label_t top_label, const std::vector<forward_t>& rules);
         void add_rule(label_t top_label, const forward_t& rule);
@@ -123,14 +138,26 @@ namespace aalwines {
         void add_rule(label_t top_label, action_t op, Interface* via, size_t weight = 0);
         void add_failover_entries(const Interface* failed_inf, Interface* backup_inf, label_t failover_label);
         void add_to_outgoing(const Interface* outgoing, action_t action);
+        // Adds the entries and rules of other. Throws base_error if an entry would get two different rules with the same priority.
         void merge(const RoutingTable& other);
+        // Replace the rules of the entry for top_label, adding the entry if it does not exist.
+        void replace_rules(label_t top_label, std::vector<forward_t> rules);
+        // Returns false if there was no entry for top_label.
+        bool remove_entry(label_t top_label);
 
         void update_interfaces(const std::function<Interface*(const Interface*)>& update_fn);
         
     private:
         std::vector<entry_t>::iterator insert_entry(label_t top_label);
+        // The first entry for top_label, or end. Works on unsorted tables.
+        std::vector<entry_t>::iterator find_entry(label_t top_label);
+        void clear_index() { _label_index.clear(); _indexed = false; }
+        static void merge_rules(entry_t& entry, const entry_t& other);
 
         std::vector<entry_t> _entries;
+        // Position of the entry for each label, built on first lookup and cleared when entries are added, moved or removed.
+        std::unordered_map<label_t, size_t> _label_index;
+        bool _indexed = false;
     };
 }
 #endif /* ROUTINGTABLE_H */
@@ -89,24 +89,26 @@ namespace aalwines {
                     throw base_error(es.str());
                 }
 
-                for (const auto& interface_name : interface_names) {
-                    auto interface = router->find_interface(interface_name);
-                    // TODO: This construction can be optimized. Currently we copy shared routing tables onto each interface.
-                    for (const auto& [label_string, json_routing_entries] : json_routing_table.items()) {
-                        auto& entry = interface->table().emplace_entry(label_string);
-
-                        if (!json_routing_entries.is_array()) {
-                            es << "error: Value of routing table entry \"" << label_string << "\" is not an array. In interface \"" << interface_name << "\" of router \"" << names.back() << "\"." << std::endl;
-                            throw base_error(es.str());
-                        }
-                        for (const auto& json_routing_entry : json_routing_entries) {
-                            auto via = router->find_interface(json_routing_entry.at("out").get<std::string>());
-                            auto ops = json_routing_entry.at("ops").get<std::vector<RoutingTable::action_t>>();
-                            auto priority = json_routing_entry.at("priority").get<size_t>();
-                            auto weight = json_routing_entry.contains("weight") ? json_routing_entry.at("weight").get<uint32_t>() : 0;
-                            entry._rules.emplace_back(std::move(ops), via, priority, weight);
-                        }
+                // The interfaces with several names share one routing table, built on the first of them.
+                auto interface = router->find_interface(interface_names[0]);
+                auto& table = interface->table();
+                for (const auto& [label_string, json_routing_entries] : json_routing_table.items()) {
+                    auto& entry = table.emplace_entry(label_string);
+
+                    if (!json_routing_entries.is_array()) {
+                        es << "error: Value of routing table entry \"" << label_string << "\" is not an array. In interface \"" << interface_names[0] << "\" of router \"" << names.back() << "\"." << std::endl;
+                        throw base_error(es.str());
                     }
+                    for (const auto& json_routing_entry : json_routing_entries) {
+                        auto via = router->find_interface(json_routing_entry.at("out").get<std::string>());
+                        auto ops = json_routing_entry.at("ops").get<std::vector<RoutingTable::action_t>>();
+                        auto priority = json_routing_entry.at("priority").get<size_t>();
+                        auto weight = json_routing_entry.contains("weight") ? json_routing_entry.at("weight").get<uint32_t>() : 0;
+                        entry._rules.emplace_back(std::move(ops), via, priority, weight);
+                    }
+                }
+                for (size_t i = 1; i < interface_names.size(); ++i) {
+                    router->find_interface(interface_names[i])->share_table(*interface);
                 }
             }
         }
@@ -152,6 +154,7 @@ namespace aalwines {
         }
 
         network.add_null_router();
+        network.share_identical_tables();
 
         return network;
     }
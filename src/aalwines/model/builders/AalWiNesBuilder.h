@@ -147,7 +147,7 @@ namespace aalwines {
         j = json::object();
         j["out"] = rule._via->get_name();
         j["priority"] = rule._priority;
-        j["ops"] = rule._ops;
+        j["ops"] = std::vector<RoutingTable::action_t>(rule._ops.begin(), rule._ops.end());
         if (rule._weight != 0) {
             j["weight"] = rule._weight;
         }
@@ -203,7 +203,7 @@ namespace nlohmann {
             for (const auto& interface : network.all_interfaces()){
                 if (interface->match() == nullptr) continue; // Not connected
                 if (interface->source()->is_null() || interface->target()->is_null()) continue; // Skip the NULL router
-                if (interface->match()->table().empty()) continue; // Not this direction
+                if (std::as_const(*interface->match()).table().empty()) continue; // Not this direction
                 assert(interface->match()->match() == interface);
                 bool bidirectional = !interface->table().empty();
                 if (interface->global_id() > interface->match()->global_id() && bidirectional) continue; // Already covered by bidirectional link the other way.
@@ -711,11 +711,11 @@ namespace aalwines {
                 current_router->set_coordinate(Coordinate(latitude, longitude));
                 break;
             case context::context_type::interface: {
-                // TODO: This construction can be optimized. Currently we copy shared routing tables onto each interface.
-                for (size_t i = 0; i < current_interfaces.size() - 1; ++i) {
-                    current_interfaces[i]->table() = current_table; // Copy assignment.
+                // The interfaces with several names share one routing table.
+                current_interfaces[0]->table() = std::move(current_table);
+                for (size_t i = 1; i < current_interfaces.size(); ++i) {
+                    current_interfaces[i]->share_table(*current_interfaces[0]);
                 }
-                current_interfaces.back()->table() = std::move(current_table); // Move the last time. No need for extra copies.
                 current_interfaces.clear();
                 break;
             }
@@ -150,6 +150,7 @@ namespace aalwines {
         Network get_network() {
             Network network(std::move(router_map), std::move(routers), std::move(all_interfaces));
             network.add_null_router();
+            network.share_identical_tables();
             network.name = network_name;
             return network;
         }
@@ -24,7 +24,9 @@
 #include "QueryBuilder.h"
 #include "parsererrors.h"
 #include "Scanner.h"
+#include "aalwines/model/NetworkTransitions.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <boost/regex.hpp>
@@ -56,6 +58,37 @@ namespace aalwines
         return parser.parse();
     }
 
+    void Builder::reset() {
+        _result.clear();
+        _result_locations.clear();
+        _links.clear();
+        _location = location();
+        _pathmode = true;
+        _post = false;
+        _link = false;
+        _inverted = false;
+    }
+
+    std::vector<std::string> Builder::query_texts(const std::string& source) const {
+        std::vector<size_t> line_begin{0};
+        for (size_t i = 0; i < source.size(); ++i) {
+            if (source[i] == '\n') line_begin.push_back(i + 1);
+        }
+        auto offset = [&](const position& p) -> size_t {
+            if (p.line < 1 || static_cast<size_t>(p.line) > line_begin.size()) return source.size();
+            return std::min(line_begin[p.line - 1] + p.column - 1, source.size());
+        };
+        std::vector<std::string> texts;
+        texts.reserve(_result_locations.size());
+        for (const auto& l : _result_locations) {
+            auto begin = offset(l.begin);
+            auto text = source.substr(begin, std::max(offset(l.end), begin) - begin);
+            text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+            texts.emplace_back(std::move(text));
+        }
+        return texts;
+    }
+
     void Builder::error(const location &l, const std::string &m) {
         throw base_parser_error(l, m);
     }
@@ -124,7 +157,7 @@ namespace aalwines
             res.insert(Query::bottom_of_stack()); // This label is used in the PDA construction to represent the bottom of the stack.
             for (const auto& r : _network.routers()) {
                 for (const auto& inf : r->interfaces()) {
-                    for (const auto& e : inf->table().entries()) {
+                    for (const auto& e : std::as_const(*inf).table().entries()) {
                         if (!e.ignores_label()) res.insert(e._top_label);
                         for (const auto& f : e._rules) {
                             for (const auto& o : f._ops) {
@@ -145,5 +178,12 @@ namespace aalwines
         return _label_cache;
     }
 
+    const NetworkTransitions& Builder::transitions() {
+        if (!_transitions_cache) {
+            _transitions_cache = std::make_shared<const NetworkTransitions>(_network);
+        }
+        return *_transitions_cache;
+    }
+
 }
 
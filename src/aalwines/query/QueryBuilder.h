@@ -60,6 +60,7 @@ namespace std {
 }
 
 namespace aalwines {
+    class NetworkTransitions;
 
     class Builder {
     public:
@@ -67,9 +68,15 @@ namespace aalwines {
 
         // Return 0 on success.
         int do_parse(std::istream &stream);
+        // Forget parsed queries and parser state, but keep the label cache, so the builder can be reused on the same network.
+        void reset();
+        // The text of each query in _result, cut out of the source that was parsed.
+        [[nodiscard]] std::vector<std::string> query_texts(const std::string& source) const;
 
         using labelset_t = std::unordered_set<Query::label_t>;
         labelset_t all_labels();
+        // The query-independent part of the PDA construction, built on first use and shared by all queries on this network.
+        const NetworkTransitions& transitions();
 
 	    // Building
 	    void path_mode() { _pathmode = true; }
@@ -99,6 +106,7 @@ namespace aalwines {
         Network& _network;
 	    location _location;
         std::vector<Query> _result;
+        std::vector<location> _result_locations; // Where each query in _result is in the source.
 
         // filtering
         labelset_t _links;
@@ -110,6 +118,7 @@ namespace aalwines {
 
     private:
         labelset_t _label_cache;
+        std::shared_ptr<const NetworkTransitions> _transitions_cache;
     };
 }
 
@@ -108,6 +108,7 @@
 
 // bison does not seem to like naked shared pointers :(
 %type  <size_t> number;
+%type  <std::pair<size_t,size_t>> failures;
 %type  <Query> query;
 %type  <NFA<size_t>> regex cregex;
 %type  <Query::mode_t> mode;
@@ -126,16 +127,30 @@
 %%
 %start query_list;
 query_list
-        : query_list query { builder._result.emplace_back(std::move($2)); }
-        | query { builder._result.emplace_back(std::move($1)); }
+        : query_list query { builder._result.emplace_back(std::move($2)); builder._result_locations.push_back(@2); }
+        | query { builder._result.emplace_back(std::move($1)); builder._result_locations.push_back(@1); }
         | END// empty 
         ;
 query
     : LT { builder.label_mode(); builder.invert(true) ; } cregex
       GT { builder.path_mode();  builder.invert(false); } cregex
-      LT { builder.label_mode(); builder.invert(false); } cregex GT number mode
+      LT { builder.label_mode(); builder.invert(false); } cregex GT failures mode
     {
-        $$ = Query(std::move($3), std::move($6), std::move($9), $11, $12);
+        $$ = Query(std::move($3), std::move($6), std::move($9), $11.first, $12);
+        if ($11.first != $11.second) {
+            $$.set_failure_range($11.first, $11.second);
+        }
+    }
+    ;
+
+failures
+    : number { $$ = std::make_pair($1, $1); }
+    | number DOT DOT number {
+        if ($4 < $1) {
+            error(@$, "The upper bound on failures must not be less than the lower bound");
+            YYERROR;
+        }
+        $$ = std::make_pair($1, $4);
     }
     ;
 
@@ -0,0 +1,73 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   budget.h
+ *
+ * Time and memory budget for a single query, checked cooperatively by the long-running parts of verification.
+ */
+
+#ifndef AALWINES_BUDGET_H
+#define AALWINES_BUDGET_H
+
+#include "errors.h"
+#include "system.h"
+#include <atomic>
+#include <chrono>
+
+namespace utils {
+    class budget_t {
+        using clock = std::chrono::steady_clock;
+    public:
+        // Unlimited budget.
+        budget_t() = default;
+
+        // timeout is in seconds and memory_limit in megabytes. 0 means no limit.
+        // The memory limit is compared with the memory usage of the whole process, not only what this query allocated.
+        budget_t(double timeout, size_t memory_limit)
+        : _has_deadline(timeout > 0), _memory_limit(memory_limit * 1024 * 1024) {
+            if (_has_deadline) {
+                _deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(timeout));
+            }
+        }
+
+        void set_cancel_flag(const std::atomic<bool>& cancel) { _cancel = &cancel; }
+
+        // Throws cancelled_error, timeout_error or memout_error when the budget is exhausted.
+        void check() {
+            if (_cancel != nullptr && _cancel->load(std::memory_order_relaxed)) {
+                throw cancelled_error();
+            }
+            if (_has_deadline && clock::now() > _deadline) {
+                throw timeout_error();
+            }
+            // Reading the memory usage is a system call, so only do it now and then.
+            if (_memory_limit > 0 && (_checks++ % memory_check_interval) == 0 && current_memory_usage() > _memory_limit) {
+                throw memout_error();
+            }
+        }
+
+    private:
+        static constexpr size_t memory_check_interval = 1024;
+
+        bool _has_deadline = false;
+        clock::time_point _deadline;
+        size_t _memory_limit = 0;
+        size_t _checks = 0;
+        const std::atomic<bool>* _cancel = nullptr;
+    };
+}
+
+#endif //AALWINES_BUDGET_H
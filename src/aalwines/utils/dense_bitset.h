@@ -0,0 +1,90 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   dense_bitset.h
+ *
+ * Fixed-size set of small integers stored as 64-bit words, with constant-time membership
+ * and iteration over the members a word at a time.
+ */
+
+#ifndef AALWINES_DENSE_BITSET_H
+#define AALWINES_DENSE_BITSET_H
+
+#include <cstdint>
+#include <vector>
+
+namespace utils {
+    class dense_bitset {
+    public:
+        dense_bitset() = default;
+        explicit dense_bitset(size_t size, bool value = false)
+        : _size(size), _words((size + 63) / 64, value ? ~uint64_t(0) : 0) {
+            clear_padding();
+        }
+
+        [[nodiscard]] size_t size() const { return _size; }
+
+        [[nodiscard]] bool test(size_t i) const {
+            return i < _size && ((_words[i >> 6] >> (i & 63)) & 1);
+        }
+        void set(size_t i) {
+            if (i < _size) _words[i >> 6] |= uint64_t(1) << (i & 63);
+        }
+        void reset(size_t i) {
+            if (i < _size) _words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+        }
+
+        // Add the members of other (of the same size). Returns whether any were new.
+        bool merge(const dense_bitset& other) {
+            bool changed = false;
+            for (size_t w = 0; w < _words.size(); ++w) {
+                auto merged = _words[w] | other._words[w];
+                changed |= merged != _words[w];
+                _words[w] = merged;
+            }
+            return changed;
+        }
+
+        [[nodiscard]] bool none() const {
+            for (auto w : _words) {
+                if (w != 0) return false;
+            }
+            return true;
+        }
+
+        // Call fn with each member in increasing order.
+        template<typename FN>
+        void for_each(FN&& fn) const {
+            for (size_t w = 0; w < _words.size(); ++w) {
+                for (auto word = _words[w]; word != 0; word &= word - 1) {
+                    fn((w << 6) + __builtin_ctzll(word));
+                }
+            }
+        }
+
+    private:
+        void clear_padding() {
+            if (_size % 64 != 0) {
+                _words.back() &= (uint64_t(1) << (_size % 64)) - 1;
+            }
+        }
+
+        size_t _size = 0;
+        std::vector<uint64_t> _words;
+    };
+}
+
+#endif //AALWINES_DENSE_BITSET_H
@@ -51,5 +51,26 @@ struct base_error : public std::exception {
     }
 };
 
+// Thrown when a computation is abandoned because its result is no longer needed.
+struct cancelled_error : public base_error {
+    cancelled_error()
+    : base_error("Computation was cancelled") {
+    }
+};
+
+// Thrown when a computation exceeds its time budget.
+struct timeout_error : public base_error {
+    timeout_error()
+    : base_error("Time limit exceeded") {
+    }
+};
+
+// Thrown when a computation exceeds its memory budget.
+struct memout_error : public base_error {
+    memout_error()
+    : base_error("Memory limit exceeded") {
+    }
+};
+
 #endif /* ERRORS_H */
 
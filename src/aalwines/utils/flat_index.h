@@ -0,0 +1,116 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   flat_index.h
+ *
+ * Assigns consecutive ids (from 0) to distinct keys, using an open-addressing hash table with linear probing.
+ * The keys are stored in a vector indexed by id, so finding the key of an id is a plain array access.
+ */
+
+#ifndef AALWINES_FLAT_INDEX_H
+#define AALWINES_FLAT_INDEX_H
+
+#include "errors.h"
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace utils {
+    template<typename K, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+    class flat_index {
+        using id_t = uint32_t; // Keeps the table small. Ids must fit, which is checked on insert.
+    public:
+        explicit flat_index(size_t expected_size = 0) {
+            reserve(expected_size);
+        }
+
+        // Returns whether the key was new, and its id.
+        std::pair<bool, size_t> insert(const K& key) {
+            if ((_keys.size() + 1) * 2 > _table.size()) { // Keep the load factor at most 1/2.
+                rehash(std::max<size_t>(minimum_capacity, _table.size() * 2));
+            }
+            auto slot = find_slot(key);
+            if (_table[slot] != empty) {
+                return std::make_pair(false, _table[slot]);
+            }
+            if (_keys.size() >= empty) {
+                throw base_error("Too many states for the state table.");
+            }
+            _table[slot] = static_cast<id_t>(_keys.size());
+            _keys.push_back(key);
+            return std::make_pair(true, _keys.size() - 1);
+        }
+
+        // Returns whether the key is present, and its id if it is.
+        [[nodiscard]] std::pair<bool, size_t> exists(const K& key) const {
+            if (_table.empty()) return std::make_pair(false, 0);
+            auto slot = find_slot(key);
+            if (_table[slot] == empty) return std::make_pair(false, 0);
+            return std::make_pair(true, _table[slot]);
+        }
+
+        [[nodiscard]] const K& operator[](size_t id) const { return _keys[id]; }
+        [[nodiscard]] size_t size() const { return _keys.size(); }
+
+        void reserve(size_t n) {
+            _keys.reserve(n);
+            size_t capacity = minimum_capacity;
+            while (capacity < 2 * n) capacity *= 2;
+            if (capacity > _table.size()) {
+                rehash(capacity);
+            }
+        }
+
+        // Bytes allocated for the keys and the hash table.
+        [[nodiscard]] size_t memory_usage() const {
+            return _keys.capacity() * sizeof(K) + _table.capacity() * sizeof(id_t);
+        }
+
+    private:
+        static constexpr id_t empty = std::numeric_limits<id_t>::max();
+        static constexpr size_t minimum_capacity = 16;
+
+        [[nodiscard]] size_t find_slot(const K& key) const {
+            auto mask = _table.size() - 1;
+            for (auto slot = _hash(key) & mask; ; slot = (slot + 1) & mask) {
+                if (_table[slot] == empty || _equal(_keys[_table[slot]], key)) {
+                    return slot;
+                }
+            }
+        }
+
+        void rehash(size_t capacity) {
+            _table.assign(capacity, empty);
+            auto mask = capacity - 1;
+            for (size_t id = 0; id < _keys.size(); ++id) {
+                auto slot = _hash(_keys[id]) & mask;
+                while (_table[slot] != empty) {
+                    slot = (slot + 1) & mask;
+                }
+                _table[slot] = static_cast<id_t>(id);
+            }
+        }
+
+        std::vector<K> _keys;
+        std::vector<id_t> _table;
+        Hash _hash;
+        Equal _equal;
+    };
+}
+
+#endif //AALWINES_FLAT_INDEX_H
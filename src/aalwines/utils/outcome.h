@@ -31,7 +31,7 @@
 #include <json.hpp>
 
 namespace utils {
-    enum class outcome_t { YES, NO, MAYBE };
+    enum class outcome_t { YES, NO, MAYBE, TIMEOUT, MEMOUT };
 
     std::ostream& operator<<(std::ostream& os, const outcome_t& outcome) {
         switch (outcome) {
@@ -44,6 +44,12 @@ namespace utils {
             case outcome_t::MAYBE:
                 os << "MAYBE";
                 break;
+            case outcome_t::TIMEOUT:
+                os << "TIMEOUT";
+                break;
+            case outcome_t::MEMOUT:
+                os << "MEMOUT";
+                break;
         }
         return os;
     }
@@ -58,8 +64,12 @@ namespace utils {
             } else {
                 outcome = outcome_t::NO;
             }
+        } else if (j.is_string() && j.get<std::string>() == "TIMEOUT") {
+            outcome = outcome_t::TIMEOUT;
+        } else if (j.is_string() && j.get<std::string>() == "MEMOUT") {
+            outcome = outcome_t::MEMOUT;
         } else {
-            throw base_error("error: outcome must be either true, false or null.");
+            throw base_error("error: outcome must be either true, false, null, \"TIMEOUT\" or \"MEMOUT\".");
         }
     }
     inline void to_json(json & j, const outcome_t& outcome) {
@@ -73,6 +83,12 @@ namespace utils {
             case outcome_t::MAYBE:
                 j = nullptr;
                 break;
+            case outcome_t::TIMEOUT:
+                j = "TIMEOUT";
+                break;
+            case outcome_t::MEMOUT:
+                j = "MEMOUT";
+                break;
         }
     }
 }
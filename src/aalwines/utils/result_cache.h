@@ -0,0 +1,104 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   result_cache.h
+ *
+ * A directory of JSON answers keyed by JSON keys. Each answer is stored in its own file named by the hash of its key,
+ * and the full key is stored next to the answer so hash collisions are detected on lookup.
+ */
+
+#ifndef AALWINES_RESULT_CACHE_H
+#define AALWINES_RESULT_CACHE_H
+
+#include "errors.h"
+#include <json.hpp>
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace utils {
+    using json = nlohmann::json;
+
+    class result_cache {
+    public:
+        explicit result_cache(boost::filesystem::path directory) : _directory(std::move(directory)) {
+            boost::system::error_code ec;
+            boost::filesystem::create_directories(_directory, ec);
+            if (ec) {
+                throw base_error("Could not create cache directory " + _directory.string() + ": " + ec.message());
+            }
+        }
+
+        [[nodiscard]] std::optional<json> lookup(const json& key) const {
+            std::ifstream in(file(key).string());
+            if (!in.is_open()) return std::nullopt;
+            try {
+                json stored;
+                in >> stored;
+                if (stored.contains("key") && stored["key"] == key && stored.contains("answer")) {
+                    return stored["answer"];
+                }
+            } catch (const nlohmann::detail::exception&) {
+                // A damaged entry is treated as a miss, and will be overwritten.
+            }
+            return std::nullopt;
+        }
+
+        void store(const json& key, const json& answer) const {
+            auto path = file(key);
+            // Write to a temporary file and rename it, so concurrent readers never see a partial entry.
+            std::stringstream tmp_name;
+            tmp_name << path.filename().string() << ".tmp." << std::this_thread::get_id() << "." << _tmp_counter++;
+            auto tmp = _directory / tmp_name.str();
+            {
+                std::ofstream out(tmp.string());
+                if (!out.is_open()) return; // The cache is only an optimization, so failing to write is not an error.
+                out << json{{"key", key}, {"answer", answer}};
+            }
+            boost::system::error_code ec;
+            boost::filesystem::rename(tmp, path, ec);
+            if (ec) boost::filesystem::remove(tmp, ec);
+        }
+
+        // 64-bit FNV-1a as a hex string.
+        static std::string hash(const std::string& data) {
+            uint64_t h = 14695981039346656037ULL;
+            for (unsigned char c : data) {
+                h ^= c;
+                h *= 1099511628211ULL;
+            }
+            std::stringstream ss;
+            ss << std::hex << std::setw(16) << std::setfill('0') << h;
+            return ss.str();
+        }
+
+    private:
+        [[nodiscard]] boost::filesystem::path file(const json& key) const {
+            return _directory / (hash(key.dump()) + ".json");
+        }
+
+        boost::filesystem::path _directory;
+        mutable std::atomic<size_t> _tmp_counter{0};
+    };
+}
+
+#endif //AALWINES_RESULT_CACHE_H
@@ -0,0 +1,177 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   small_vector.h
+ *
+ * A vector that stores up to N elements inline and only allocates when it grows beyond that.
+ * For short lists that are almost always small, like the operations of a forwarding rule.
+ * Only for trivially copyable elements, which are copied and moved as raw memory.
+ */
+
+#ifndef AALWINES_SMALL_VECTOR_H
+#define AALWINES_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace utils {
+    template<typename T, size_t N>
+    class small_vector {
+        static_assert(std::is_trivially_copyable_v<T>, "small_vector only supports trivially copyable elements.");
+        static_assert(N > 0, "Use std::vector without inline storage.");
+    public:
+        using value_type = T;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        small_vector() = default;
+        small_vector(std::initializer_list<T> init) { assign(init.begin(), init.end()); }
+        small_vector(const std::vector<T>& other) { assign(other.begin(), other.end()); }
+        template<typename It>
+        small_vector(It first, It last) { assign(first, last); }
+        small_vector(const small_vector& other) { assign(other.begin(), other.end()); }
+        small_vector(small_vector&& other) noexcept { steal(std::move(other)); }
+        ~small_vector() { release(); }
+
+        small_vector& operator=(const small_vector& other) {
+            if (this != &other) {
+                clear();
+                assign(other.begin(), other.end());
+            }
+            return *this;
+        }
+        small_vector& operator=(small_vector&& other) noexcept {
+            if (this != &other) {
+                release();
+                steal(std::move(other));
+            }
+            return *this;
+        }
+
+        [[nodiscard]] size_t size() const { return _size; }
+        [[nodiscard]] bool empty() const { return _size == 0; }
+        [[nodiscard]] size_t capacity() const { return _capacity; }
+
+        T* data() { return on_heap() ? _heap : reinterpret_cast<T*>(_inline); }
+        const T* data() const { return on_heap() ? _heap : reinterpret_cast<const T*>(_inline); }
+        iterator begin() { return data(); }
+        iterator end() { return data() + _size; }
+        const_iterator begin() const { return data(); }
+        const_iterator end() const { return data() + _size; }
+
+        T& operator[](size_t i) { return data()[i]; }
+        const T& operator[](size_t i) const { return data()[i]; }
+        T& front() { return data()[0]; }
+        const T& front() const { return data()[0]; }
+        T& back() { return data()[_size - 1]; }
+        const T& back() const { return data()[_size - 1]; }
+
+        void reserve(size_t capacity) {
+            if (capacity <= _capacity) return;
+            move_to(std::allocator<T>().allocate(capacity), capacity);
+        }
+
+        template<typename... Args>
+        T& emplace_back(Args&&... args) {
+            if (_size < _capacity) {
+                T* element = ::new (static_cast<void*>(data() + _size)) T(std::forward<Args>(args)...);
+                ++_size;
+                return *element;
+            }
+            // Like std::vector, construct the new element before the old storage is released, as args may refer into it.
+            size_t capacity = 2 * _capacity;
+            T* heap = std::allocator<T>().allocate(capacity);
+            T* element = ::new (static_cast<void*>(heap + _size)) T(std::forward<Args>(args)...);
+            move_to(heap, capacity);
+            ++_size;
+            return *element;
+        }
+        void push_back(const T& value) { emplace_back(value); }
+        void pop_back() { --_size; }
+        iterator insert(const_iterator pos, const T& value) {
+            auto index = pos - begin();
+            emplace_back(value);
+            std::rotate(begin() + index, end() - 1, end());
+            return begin() + index;
+        }
+        void clear() { _size = 0; }
+
+        bool operator==(const small_vector& other) const {
+            return _size == other._size && std::equal(begin(), end(), other.begin());
+        }
+        bool operator!=(const small_vector& other) const { return !(*this == other); }
+
+    private:
+        [[nodiscard]] bool on_heap() const { return _capacity > N; }
+
+        template<typename It>
+        void assign(It first, It last) {
+            reserve(std::distance(first, last));
+            for (; first != last; ++first) {
+                emplace_back(*first);
+            }
+        }
+
+        // Moves the elements to heap, which has room for capacity elements, and releases the old storage.
+        void move_to(T* heap, size_t capacity) {
+            std::memcpy(static_cast<void*>(heap), static_cast<const void*>(data()), _size * sizeof(T));
+            release();
+            _heap = heap;
+            _capacity = static_cast<uint32_t>(capacity);
+        }
+
+        void release() {
+            if (on_heap()) {
+                std::allocator<T>().deallocate(_heap, _capacity);
+                _capacity = N;
+            }
+        }
+
+        void steal(small_vector&& other) {
+            _size = other._size;
+            _capacity = other._capacity;
+            if (other.on_heap()) {
+                _heap = other._heap;
+            } else {
+                std::memcpy(static_cast<void*>(_inline), static_cast<const void*>(other._inline), _size * sizeof(T));
+            }
+            other._size = 0;
+            other._capacity = N;
+        }
+
+        uint32_t _size = 0;
+        uint32_t _capacity = N;
+        union {
+            alignas(T) unsigned char _inline[N * sizeof(T)];
+            T* _heap;
+        };
+    };
+}
+
+#endif //AALWINES_SMALL_VECTOR_H
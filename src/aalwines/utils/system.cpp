@@ -25,6 +25,8 @@
 #include <stdexcept>
 #include <string>
 #include <array>
+#include <fstream>
+#include <unistd.h>
 
 // Blatantly stolen from https://stackoverflow.com/questions/478898/how-do-i-execute-a-command-and-get-output-of-command-within-c-using-posix
 #include <sstream>
@@ -54,3 +56,36 @@ std::string get_env_var(const char* key)
     char * val = getenv(key);
     return val == nullptr ? std::string("") : std::string(val);
 }
+
+size_t current_memory_usage()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    if (!(statm >> size >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t peak_memory_usage()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            std::istringstream value(line.substr(6));
+            size_t kb = 0;
+            value >> kb;
+            return kb * 1024;
+        }
+    }
+    return 0;
+}
+
+bool reset_peak_memory_usage()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5"; // Resets VmHWM (Linux 4.0 and later).
+    clear_refs.flush();
+    return clear_refs.good();
+}
@@ -32,6 +32,12 @@
 std::string exec(const char* cmd);
 std::string get_env_var( std::string const & key );
 std::string get_env_var( const char* key );
+// Resident memory of this process in bytes, or 0 if it cannot be determined.
+size_t current_memory_usage();
+// Peak resident memory of this process in bytes since it started or since the last reset, or 0 if it cannot be determined.
+size_t peak_memory_usage();
+// Reset the peak resident memory to the current resident memory. Returns false if that is not supported.
+bool reset_peak_memory_usage();
 
 #endif /* SYSTEM_H */
 
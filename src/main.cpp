@@ -30,6 +30,7 @@
 
 #include <aalwines/model/NetworkPDAFactory.h>
 #include <aalwines/model/NetworkWeight.h>
+#include <aalwines/model/NetworkDelta.h>
 
 #include <aalwines/query/parsererrors.h>
 #include <pdaaal/PDAFactory.h>
@@ -38,6 +39,7 @@
 #include <aalwines/utils/stopwatch.h>
 #include <aalwines/utils/outcome.h>
 #include <aalwines/Verifier.h>
+#include <aalwines/VerificationServer.h>
 
 #include <aalwines/model/builders/NetworkParsing.h>
 
@@ -47,6 +49,7 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 
 namespace po = boost::program_options;
 using namespace aalwines;
@@ -90,9 +93,17 @@ int main(int argc, const char** argv)
 
     std::string query_file;
     std::string weight_file;
+    bool server = false;
+    std::string socket_path;
+    std::string delta_file;
+    std::string previous_answers_file;
     verifier.add_options()
             ("query,q", po::value<std::string>(&query_file), "A file containing valid queries over the input network.")
-            ("weight,w", po::value<std::string>(&weight_file), "A file containing the weight function expression");
+            ("weight,w", po::value<std::string>(&weight_file), "A file containing the weight function expression")
+            ("server", po::bool_switch(&server), "Keep the network loaded and answer queries sent as newline-delimited JSON on stdin, e.g. {\"id\":1, \"query\":\"<.> [.#R0] .* [R1#.] <.> 0 OVER\", \"weight\":[...]}. One JSON answer is written per line.")
+            ("socket", po::value<std::string>(&socket_path), "Serve requests on this Unix socket instead of stdin (implies --server).")
+            ("delta", po::value<std::string>(&delta_file), "A file with changes to routing table entries, which are applied to the network before verification.")
+            ("previous-answers", po::value<std::string>(&previous_answers_file), "Output (with --footprint) of an earlier run on the network before --delta. Answers to queries not affected by the delta are reused instead of verified again.");
 
     opts.add(parser.options());
     opts.add(output);
@@ -109,9 +120,50 @@ int main(int argc, const char** argv)
     verifier.check_settings();
 
     if(silent) no_parser_warnings = true;
+    if(!socket_path.empty()) server = true;
+    if(server && (!query_file.empty() || !weight_file.empty())) {
+        std::cerr << "--server cannot be combined with --query or --weight. Send queries and weights as requests instead." << std::endl;
+        exit(-1);
+    }
 
     auto network = parser.parse(no_parser_warnings);
 
+    NetworkDelta delta;
+    if (!delta_file.empty()) {
+        std::ifstream dstream(delta_file);
+        if (!dstream.is_open()) {
+            std::cerr << "Could not open --delta\"" << delta_file << "\"" << std::endl;
+            exit(-1);
+        }
+        try {
+            json j;
+            dstream >> j;
+            delta = NetworkDelta(j);
+            delta.apply(network);
+        } catch (base_error& error) {
+            std::cerr << "Error while applying network delta:" << error << std::endl;
+            exit(-1);
+        } catch (nlohmann::detail::exception& error) {
+            std::cerr << "Error while parsing network delta:" << error.what() << std::endl;
+            exit(-1);
+        }
+    }
+    if (!previous_answers_file.empty()) {
+        std::ifstream pstream(previous_answers_file);
+        if (!pstream.is_open()) {
+            std::cerr << "Could not open --previous-answers\"" << previous_answers_file << "\"" << std::endl;
+            exit(-1);
+        }
+        try {
+            json j;
+            pstream >> j;
+            verifier.set_previous_answers(j.contains("answers") ? j["answers"] : j, delta);
+        } catch (nlohmann::detail::exception& error) {
+            std::cerr << "Error while parsing previous answers:" << error.what() << std::endl;
+            exit(-1);
+        }
+    }
+
     if (print_dot) {
         network.print_dot(std::cout);
     }
@@ -156,6 +208,21 @@ int main(int argc, const char** argv)
     if (print_net) {
         network.print_json(json_output);
     }
+    if (server) {
+        json_output.close();
+        VerificationServer verification_server(network, verifier, !no_timing);
+        try {
+            if (socket_path.empty()) {
+                verification_server.serve(std::cin, std::cout);
+            } else {
+                verification_server.serve_socket(socket_path);
+            }
+        } catch (base_error& error) {
+            std::cerr << error << std::endl;
+            exit(-1);
+        }
+        return 0;
+    }
     std::vector<std::string> query_strings;
     if(!query_file.empty()) {
         stopwatch queryparsingwatch;
@@ -167,15 +234,12 @@ int main(int argc, const char** argv)
                 exit(-1);
             }
             try {
-                std::string str;
-                while(getline(qstream, str)){
-                    str.erase(std::remove(str.begin(), str.end(), '\r'), str.end());
-                    query_strings.emplace_back(str);
-                }
-                qstream.close();
-                std::ifstream qstream(query_file);
-                builder.do_parse(qstream);
+                std::stringstream query_text;
+                query_text << qstream.rdbuf();
                 qstream.close();
+                builder.do_parse(query_text);
+                // A line may hold several queries, or none, so take the text of each query from where it was parsed.
+                query_strings = builder.query_texts(query_text.str());
             }
             catch(base_parser_error& error)
             {
@@ -196,8 +260,12 @@ int main(int argc, const char** argv)
                     exit(-1);
                 }
                 try {
-                    weight_fn.emplace(network_weight.parse(wstream));
+                    std::stringstream weight_text;
+                    weight_text << wstream.rdbuf();
                     wstream.close();
+                    verifier.set_cache_weight(json::parse(weight_text.str()).dump());
+                    weight_text.seekg(0);
+                    weight_fn.emplace(network_weight.parse(weight_text));
                 } catch (base_error& error) {
                     std::cerr << "Error while parsing weight function:" << error << std::endl;
                     exit(-1);
@@ -102,3 +102,83 @@ BOOST_AUTO_TEST_CASE(NetworkCopy) {
     BOOST_CHECK_EQUAL(new_i3->match(), nullptr);
 }
 
+
+BOOST_AUTO_TEST_CASE(SharedRoutingTable) {
+    Network network("Testnet");
+    auto router1 = network.add_router("router1");
+    auto i0 = network.insert_interface_to("i0", router1).second;
+    auto i1 = network.insert_interface_to("i1", router1).second;
+    auto i2 = network.insert_interface_to("i2", router1).second;
+    i0->table().add_rule(RoutingTable::label_t(10), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t(11)), i2);
+    i1->share_table(*i0);
+    BOOST_CHECK_EQUAL(&std::as_const(*i0).table(), &std::as_const(*i1).table());
+
+    Network new_network(network); // Copy keeps the table shared, with the rules pointing to the new interfaces.
+    auto new_router1 = new_network.find_router("router1");
+    auto new_i0 = new_router1->find_interface("i0");
+    auto new_i1 = new_router1->find_interface("i1");
+    auto new_i2 = new_router1->find_interface("i2");
+    BOOST_CHECK_EQUAL(&std::as_const(*new_i0).table(), &std::as_const(*new_i1).table());
+    BOOST_CHECK_NE(&std::as_const(*new_i0).table(), &std::as_const(*i0).table());
+    BOOST_CHECK_EQUAL(std::as_const(*new_i1).table().entries()[0]._rules[0]._via, new_i2);
+
+    // Changing the table of one interface copies it first.
+    i1->table().add_rule(RoutingTable::label_t(12), RoutingTable::action_t(RoutingTable::op_t::POP), i2);
+    BOOST_CHECK_NE(&std::as_const(*i0).table(), &std::as_const(*i1).table());
+    BOOST_CHECK_EQUAL(std::as_const(*i0).table().entries().size(), 1);
+    BOOST_CHECK_EQUAL(std::as_const(*i1).table().entries().size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(MergeRoutingTables) {
+    Network network("Testnet");
+    auto router1 = network.add_router("router1");
+    auto i1 = network.insert_interface_to("i1", router1).second;
+    auto i2 = network.insert_interface_to("i2", router1).second;
+    auto rule = [](Interface* via, size_t priority, RoutingTable::label_t label) {
+        return RoutingTable::forward_t({RoutingTable::action_t(RoutingTable::op_t::SWAP, label)}, via, priority);
+    };
+    RoutingTable table;
+    table.add_rule(RoutingTable::label_t(10), rule(i1, 0, 11));
+    RoutingTable other;
+    other.add_rule(RoutingTable::label_t(10), rule(i2, 1, 12));
+    other.add_rule(RoutingTable::label_t(10), rule(i1, 0, 11));
+    other.add_rule(RoutingTable::label_t(20), rule(i2, 0, 21));
+    table.merge(other); // Duplicates are skipped and new priorities are added.
+    BOOST_CHECK_EQUAL(table.entries().size(), 2);
+    BOOST_CHECK_EQUAL(table.entries()[0]._rules.size(), 2);
+    BOOST_CHECK(table.entries()[0]._rules[1] == rule(i2, 1, 12));
+    table.merge(other);
+    BOOST_CHECK_EQUAL(table.entries()[0]._rules.size(), 2);
+
+    RoutingTable clash;
+    clash.add_rule(RoutingTable::label_t(10), rule(i2, 0, 13));
+    BOOST_CHECK_THROW(table.merge(clash), base_error);
+    BOOST_CHECK_EQUAL(table.entries()[0]._rules.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(ShareIdenticalTables) {
+    Network network("Testnet");
+    auto router1 = network.add_router("router1");
+    auto i0 = network.insert_interface_to("i0", router1).second;
+    auto i1 = network.insert_interface_to("i1", router1).second;
+    auto i2 = network.insert_interface_to("i2", router1).second;
+    auto i3 = network.insert_interface_to("i3", router1).second;
+    // i0 and i1 have equal tables built separately, i2 differs only in the weight of its rule.
+    i0->table().add_rule(RoutingTable::label_t(10), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t(11)), i3);
+    i1->table().add_rule(RoutingTable::label_t(10), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t(11)), i3);
+    i2->table().add_rule(RoutingTable::label_t(10), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t(11)), i3, 1);
+    BOOST_CHECK(std::as_const(*i0).table().same_content(std::as_const(*i1).table()));
+    BOOST_CHECK_EQUAL(std::as_const(*i0).table().content_hash(), std::as_const(*i1).table().content_hash());
+    BOOST_CHECK(!std::as_const(*i0).table().same_content(std::as_const(*i2).table()));
+
+    network.share_identical_tables();
+    BOOST_CHECK_EQUAL(&std::as_const(*i0).table(), &std::as_const(*i1).table());
+    BOOST_CHECK_NE(&std::as_const(*i0).table(), &std::as_const(*i2).table());
+    BOOST_CHECK_NE(&std::as_const(*i0).table(), &std::as_const(*i3).table());
+
+    // Changing the table of one interface un-shares it.
+    i1->table().add_rule(RoutingTable::label_t(12), RoutingTable::action_t(RoutingTable::op_t::POP), i3);
+    BOOST_CHECK_NE(&std::as_const(*i0).table(), &std::as_const(*i1).table());
+    BOOST_CHECK_EQUAL(std::as_const(*i0).table().entries().size(), 1);
+    BOOST_CHECK_EQUAL(std::as_const(*i1).table().entries().size(), 2);
+}
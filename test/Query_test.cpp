@@ -29,7 +29,10 @@
 #include <boost/test/unit_test.hpp>
 #include <aalwines/model/Network.h>
 #include <aalwines/Verifier.h>
+#include <aalwines/VerificationServer.h>
+#include <aalwines/model/NetworkDelta.h>
 #include <aalwines/synthesis/RouteConstruction.h>
+#include <boost/filesystem.hpp>
 
 using namespace aalwines;
 
@@ -81,4 +84,497 @@ BOOST_AUTO_TEST_CASE(QueryTest2) {
         BOOST_CHECK_EQUAL(result, utils::outcome_t::YES);
         BOOST_TEST_MESSAGE(output["trace"]);
     }
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE(ParallelQueriesTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(2)->find_interface("iRouter2"), next_label);
+
+    std::vector<std::string> query_strings{
+        "<.> [.#Router0] .* [Router2#.] <.> 0 OVER",
+        "<.> [.#Router2] .* [Router0#.] <.> 0 OVER",
+        "<.> [.#Router0] [Router0#Router1] [Router1#.] <.> 0 UNDER",
+        "<.> [.#Router0] .* [Router2#.] <.> 1 DUAL",
+        "<.> [.#Router1] .* [Router0#.] <.> 0 OVER",
+    };
+    std::stringstream query;
+    for (const auto& q : query_strings) query << q << "\n";
+
+    auto run = [&](size_t threads) {
+        Builder builder(network);
+        std::istringstream qstream(query.str());
+        builder.do_parse(qstream);
+        Verifier verifier;
+        verifier.set_print_trace();
+        verifier.set_threads(threads);
+        std::stringstream output;
+        {
+            json_stream json_output(4, output);
+            json_output.begin_object("answers");
+            verifier.run(builder, query_strings, json_output, false);
+            json_output.end_object();
+        }
+        return output.str();
+    };
+    auto sequential = run(1);
+    auto parallel = run(4);
+    BOOST_CHECK_EQUAL(sequential, parallel);
+    BOOST_CHECK(sequential.find("\"Q1\"") < sequential.find("\"Q5\""));
+}
+
+BOOST_AUTO_TEST_CASE(SpeculativeDualTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(2)->find_interface("iRouter2"), next_label);
+
+    std::vector<std::string> query_strings{
+        "<.> [.#Router0] .* [Router2#.] <.> 1 DUAL",
+        "<.> [.#Router2] .* [Router0#.] <.> 1 DUAL",
+        "<.> [.#Router0] [Router0#Router1] [Router1#.] <.> 2 DUAL",
+    };
+    for (const auto& query_string : query_strings) {
+        auto run = [&](bool speculative) {
+            Builder builder(network);
+            std::istringstream qstream(query_string);
+            builder.do_parse(qstream);
+            Verifier verifier;
+            if (speculative) verifier.set_speculative_dual();
+            return verifier.run_once(builder, builder._result[0], false);
+        };
+        auto sequential = run(false);
+        auto speculative = run(true);
+        BOOST_CHECK_EQUAL(sequential["result"], speculative["result"]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TimeoutTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(2)->find_interface("iRouter2"), next_label);
+
+    std::vector<std::string> query_strings{
+        "<.> [.#Router0] .* [Router2#.] <.> 0 OVER",
+        "<.> [.#Router0] .* [Router2#.] <.> 1 DUAL",
+    };
+    std::stringstream query;
+    for (const auto& q : query_strings) query << q << "\n";
+    Builder builder(network);
+    builder.do_parse(query);
+
+    Verifier verifier;
+    verifier.set_timeout(1e-9);
+    for (auto& q : builder._result) {
+        auto output = verifier.run_once(builder, q, false);
+        BOOST_CHECK_EQUAL(output["result"].get<utils::outcome_t>(), utils::outcome_t::TIMEOUT);
+    }
+    verifier.set_timeout(0);
+    auto output = verifier.run_once(builder, builder._result[0], false);
+    BOOST_CHECK_EQUAL(output["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+}
+
+BOOST_AUTO_TEST_CASE(VerificationServerTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(2)->find_interface("iRouter2"), next_label);
+
+    Verifier verifier;
+    VerificationServer server(network, verifier, false);
+    std::stringstream requests;
+    requests << R"({"id": 1, "query": "<.> [.#Router0] .* [Router2#.] <.> 0 OVER"})" << "\n";
+    requests << R"({"id": 2, "query": "<.> [.#Router0] .* [Router2#.] <.> 0 OVER", "weight": [[{"atom": "hops"}]]})" << "\n";
+    requests << R"({"id": 3, "query": "<.> [.#Router0] .* [Router2#.] <.> 0 OVER <.> [.#Router0] .* [Router2#.] <.> 0 OVER"})" << "\n";
+    requests << R"({"id": 4, "query": "<.> [.#Router0 .* [Router2#.] <.> 0 OVER"})" << "\n";
+    requests << "not json" << "\n";
+    requests << R"({"id": 5, "query": "<.> [.#Router0] .* [Router2#.] <.> 0 OVER", "weight": [[{"atom": "hops", "factor": "two"}]]})" << "\n";
+    requests << R"({"id": 6, "query": "<.> [.#Router0] .* [Router2#.] <.> 0 OVER"})" << "\n";
+    std::stringstream answers;
+    server.serve(requests, answers);
+
+    std::vector<json> responses;
+    std::string line;
+    while (std::getline(answers, line)) {
+        responses.push_back(json::parse(line));
+    }
+    BOOST_REQUIRE_EQUAL(responses.size(), 7);
+    BOOST_CHECK_EQUAL(responses[0]["id"], 1);
+    BOOST_CHECK_EQUAL(responses[0]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_CHECK_EQUAL(responses[0]["query"], "<.> [.#Router0] .* [Router2#.] <.> 0 OVER");
+    BOOST_CHECK_EQUAL(responses[1]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_CHECK(responses[2].contains("error"));
+    BOOST_CHECK(responses[3].contains("error"));
+    BOOST_CHECK_EQUAL(responses[3]["id"], 4);
+    BOOST_CHECK(responses[4].contains("error"));
+    // A malformed weight gives an error, and the server still answers the next request.
+    BOOST_CHECK(responses[5].contains("error"));
+    BOOST_CHECK_EQUAL(responses[5]["id"], 5);
+    BOOST_CHECK_EQUAL(responses[6]["id"], 6);
+    BOOST_CHECK_EQUAL(responses[6]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+
+    // The server does not delete a file that is not a socket to listen on its path.
+    auto not_a_socket = boost::filesystem::temp_directory_path() / "aalwines_server_test_file";
+    std::ofstream(not_a_socket.string()) << "keep";
+    BOOST_CHECK_THROW(server.serve_socket(not_a_socket.string()), base_error);
+    BOOST_CHECK(boost::filesystem::is_regular_file(not_a_socket));
+    boost::filesystem::remove(not_a_socket);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTextsTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"}};
+    auto network = Network::make_network(routers, links);
+
+    std::string source = "// Comment\n"
+                         "\n"
+                         "<.> [.#Router0] .* [Router2#.] <.> 0 OVER  <.> [.#Router2] .* [Router0#.] <.> 0 OVER\r\n"
+                         "/* Two\nlines */ <.> [.#Router1]\n  .* [Router0#.] <.> 0 OVER\n";
+    Builder builder(network);
+    std::istringstream qstream(source);
+    builder.do_parse(qstream);
+    auto texts = builder.query_texts(source);
+    BOOST_REQUIRE_EQUAL(texts.size(), 3);
+    BOOST_CHECK_EQUAL(texts[0], "<.> [.#Router0] .* [Router2#.] <.> 0 OVER");
+    BOOST_CHECK_EQUAL(texts[1], "<.> [.#Router2] .* [Router0#.] <.> 0 OVER");
+    BOOST_CHECK_EQUAL(texts[2], "<.> [.#Router1]\n  .* [Router0#.] <.> 0 OVER");
+}
+
+BOOST_AUTO_TEST_CASE(ResultCacheTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(2)->find_interface("iRouter2"), next_label);
+
+    std::vector<std::string> query_strings{
+        "<.> [.#Router0] .* [Router2#.] <.> 0 OVER",
+        "<.> [.#Router2] .* [Router0#.] <.> 0 OVER",
+    };
+    auto cache_dir = boost::filesystem::temp_directory_path() / "aalwines_result_cache_test";
+    boost::filesystem::remove_all(cache_dir);
+
+    auto run = [&](const std::string& source, bool print_timing_and_stats = false) {
+        Builder builder(network);
+        std::istringstream query(source);
+        builder.do_parse(query);
+        Verifier verifier;
+        verifier.set_print_trace();
+        verifier.set_cache_dir(cache_dir.string());
+        if (print_timing_and_stats) verifier.set_print_stats();
+        std::stringstream output;
+        {
+            json_stream json_output(4, output);
+            json_output.begin_object("answers");
+            verifier.run(builder, builder.query_texts(source), json_output, print_timing_and_stats);
+            json_output.end_object();
+        }
+        return json::parse(output.str())["answers"];
+    };
+    auto first = run(query_strings[0] + "\n" + query_strings[1] + "\n");
+    auto second = run(query_strings[0] + "\n" + query_strings[1] + "\n");
+    for (const auto& q : {"Q1", "Q2"}) {
+        BOOST_CHECK(!first[q].contains("cached"));
+        BOOST_CHECK(second[q].contains("cached"));
+        second[q].erase("cached");
+        BOOST_CHECK_EQUAL(first[q], second[q]);
+    }
+    // A cached answer does not report the time or statistics of the run that computed it.
+    auto computed = run(query_strings[0] + "\n", true);
+    BOOST_CHECK(!computed["Q1"].contains("cached"));
+    BOOST_CHECK(computed["Q1"].contains("verification-time"));
+    BOOST_CHECK(computed["Q1"].contains("stats"));
+    auto timed = run(query_strings[0] + "\n", true);
+    BOOST_CHECK(timed["Q1"].contains("cached"));
+    BOOST_CHECK(!timed["Q1"].contains("verification-time"));
+    BOOST_CHECK(!timed["Q1"].contains("stats"));
+    // Queries are cached by their own text, not by the line they are on.
+    auto moved = run("// Swapped, on one line\n\n" + query_strings[1] + " " + query_strings[0] + "\n");
+    BOOST_CHECK(moved["Q1"].contains("cached"));
+    BOOST_CHECK_EQUAL(moved["Q1"]["query"], query_strings[1]);
+    BOOST_CHECK_EQUAL(moved["Q1"]["result"], first["Q2"]["result"]);
+    BOOST_CHECK_EQUAL(moved["Q2"]["result"], first["Q1"]["result"]);
+    boost::filesystem::remove_all(cache_dir);
+}
+
+BOOST_AUTO_TEST_CASE(IncrementalDeltaTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2", "Router3"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"},{}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(2)->find_interface("iRouter2"), next_label);
+
+    std::vector<std::string> query_strings{
+        "<.> [.#Router0] .* [Router2#.] <.> 0 OVER",
+        "<.> [.#Router3] .* [Router3#.] <.> 0 OVER",
+    };
+    auto run = [&](Verifier& verifier) {
+        Builder builder(network);
+        std::stringstream query;
+        for (const auto& q : query_strings) query << q << "\n";
+        builder.do_parse(query);
+        std::stringstream output;
+        {
+            json_stream json_output(4, output);
+            json_output.begin_object("answers");
+            verifier.run(builder, query_strings, json_output, false);
+            json_output.end_object();
+        }
+        return json::parse(output.str())["answers"];
+    };
+    Verifier before_verifier;
+    before_verifier.set_print_footprint();
+    auto before = run(before_verifier);
+    BOOST_CHECK_EQUAL(before["Q1"]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_CHECK_EQUAL(before["Q2"]["result"].get<utils::outcome_t>(), utils::outcome_t::NO);
+
+    // Route an existing label through the otherwise unused Router3, so the set of labels stays the same.
+    NetworkDelta delta(json::parse(R"({"changes": [{"router": "Router3", "interface": "iRouter3", "label": "42",
+                                       "rules": [{"out": "iRouter3", "ops": [{"swap": "43"}], "priority": 0}]}]})"));
+    delta.apply(network);
+    BOOST_CHECK(!delta.labels_changed());
+
+    Verifier incremental_verifier;
+    incremental_verifier.set_previous_answers(before, delta);
+    auto incremental = run(incremental_verifier);
+    Verifier fresh_verifier;
+    auto fresh = run(fresh_verifier);
+
+    BOOST_CHECK(incremental["Q1"].contains("reused"));
+    BOOST_CHECK(!incremental["Q2"].contains("reused"));
+    BOOST_CHECK_EQUAL(incremental["Q2"]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    for (const auto& q : {"Q1", "Q2"}) {
+        BOOST_CHECK_EQUAL(incremental[q]["result"], fresh[q]["result"]);
+    }
+
+    // An answer from a run with other settings is not reused, e.g. it has no trace when one is asked for now.
+    Verifier trace_verifier;
+    trace_verifier.set_print_trace();
+    trace_verifier.set_previous_answers(before, delta);
+    auto traced = run(trace_verifier);
+    BOOST_CHECK(!traced["Q1"].contains("reused"));
+    BOOST_CHECK(traced["Q1"].contains("trace"));
+    BOOST_CHECK_EQUAL(traced["Q1"]["result"], fresh["Q1"]["result"]);
+}
+
+BOOST_AUTO_TEST_CASE(StatisticsTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(2)->find_interface("iRouter2"), next_label);
+
+    Builder builder(network);
+    std::istringstream query("<.> [.#Router0] .* [Router2#.] <.> 0 DUAL");
+    builder.do_parse(query);
+    Verifier verifier;
+    verifier.set_print_stats();
+    auto answer = verifier.run_once(builder, builder._result[0], false);
+
+    BOOST_CHECK_EQUAL(answer["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_REQUIRE(answer.contains("stats"));
+    BOOST_REQUIRE_EQUAL(answer["stats"].size(), 1); // OVER is conclusive, so UNDER is not run.
+    auto stats = answer["stats"][0];
+    BOOST_CHECK_EQUAL(stats["mode"], "OVER");
+    BOOST_CHECK_GT(stats["pda-states"].get<size_t>(), 0);
+    BOOST_CHECK_GT(stats["pda-rules"].get<size_t>(), 0);
+    BOOST_CHECK_GT(stats["initial-states"].get<size_t>(), 0);
+    BOOST_CHECK_GT(stats["nfa"]["path"]["states"].get<size_t>(), 0);
+    BOOST_CHECK(stats.contains("peak-memory") || stats.contains("process-peak-memory"));
+    BOOST_CHECK(stats.contains("concretization-attempts"));
+
+    // When modes may run concurrently, the peak memory cannot be attributed to one mode.
+    Verifier speculative_verifier;
+    speculative_verifier.set_print_stats();
+    speculative_verifier.set_speculative_dual();
+    auto speculative = speculative_verifier.run_once(builder, builder._result[0], false);
+    BOOST_REQUIRE(speculative.contains("stats"));
+    for (const auto& mode_stats : speculative["stats"]) {
+        BOOST_CHECK(!mode_stats.contains("peak-memory"));
+        BOOST_CHECK(mode_stats.contains("process-peak-memory"));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FailureSweepTest) {
+    std::vector<std::string> names{"Router1", "Router2", "Router3", "Router4", "Router5", "Router6"};
+    std::vector<std::vector<std::string>> links{{"Router2"},
+                                                {"Router1", "Router3", "Router5"},
+                                                {"Router2", "Router4"},
+                                                {"Router3", "Router5"},
+                                                {"Router2", "Router4", "Router6"},
+                                                {"Router5"}};
+    auto network = Network::make_network(names, links);
+    std::vector<const Router*> path {network.get_router(0),
+                                     network.get_router(1),
+                                     network.get_router(4),
+                                     network.get_router(5)};
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter1"), network.get_router(5)->find_interface("iRouter6"), next_label, path);
+    RouteConstruction::make_reroute(network.get_router(1)->find_interface("Router5"), next_label);
+
+    // Avoiding the link from Router2 to Router5 is only possible when it fails.
+    Builder builder(network);
+    std::istringstream query("<.> [.#Router1] [^Router2#Router5]* [Router6#.] <.> 0..2 DUAL");
+    builder.do_parse(query);
+    BOOST_REQUIRE(builder._result[0].failure_range());
+    Verifier verifier;
+    auto answer = verifier.run_once(builder, builder._result[0], false);
+
+    BOOST_CHECK_EQUAL(answer["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_CHECK_EQUAL(answer["failures"], 1);
+    BOOST_REQUIRE_EQUAL(answer["sweep"].size(), 2);
+    BOOST_CHECK_EQUAL(answer["sweep"][0]["result"].get<utils::outcome_t>(), utils::outcome_t::NO);
+
+    // Each bound of the sweep gives the same answer as verifying the query with just that bound.
+    for (const auto& step : answer["sweep"]) {
+        Builder single_builder(network);
+        std::istringstream single_query("<.> [.#Router1] [^Router2#Router5]* [Router6#.] <.> " + std::to_string(step["failures"].get<int>()) + " DUAL");
+        single_builder.do_parse(single_query);
+        auto single = verifier.run_once(single_builder, single_builder._result[0], false);
+        BOOST_CHECK_EQUAL(step["result"], single["result"]);
+        BOOST_CHECK_EQUAL(step["mode"], single["mode"]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(PruningTest) {
+    std::vector<std::string> names{"Router1", "Router2", "Router3", "Router4", "Router5", "Router6"};
+    std::vector<std::vector<std::string>> links{{"Router2"},
+                                                {"Router1", "Router3", "Router5"},
+                                                {"Router2", "Router4"},
+                                                {"Router3", "Router5"},
+                                                {"Router2", "Router4", "Router6"},
+                                                {"Router5"}};
+    auto network = Network::make_network(names, links);
+    std::vector<const Router*> path {network.get_router(0),
+                                     network.get_router(1),
+                                     network.get_router(4),
+                                     network.get_router(5)};
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter1"), network.get_router(5)->find_interface("iRouter6"), next_label, path);
+    RouteConstruction::make_reroute(network.get_router(1)->find_interface("Router5"), next_label);
+
+    auto verify = [&](const std::string& query, bool prune) {
+        Builder builder(network);
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+        Verifier verifier;
+        verifier.set_print_trace();
+        verifier.set_pruning(prune);
+        return verifier.run_once(builder, builder._result[0], false);
+    };
+    std::vector<std::string> paths{
+        "<.> [.#Router1] .* [Router6#.] <.>",
+        "<.> [.#Router1] [^Router2#Router5]* [Router6#.] <.>", // Only through the reroute around the link Router2-Router5.
+        "<.> [.#Router1] .* [Router3#Router4] .* [Router6#.] <.>",
+        "<.> [.#Router6] .* [Router1#.] <.>",
+        "<42 .> [.#Router1] .* <.>",
+        "<.> .* [Router4#.] <.>",
+    };
+    for (const auto& p : paths) {
+        for (const auto& failures : {"0", "1"}) {
+            for (const auto& mode : {"OVER", "UNDER", "DUAL"}) {
+                auto query = p + " " + failures + " " + mode;
+                auto pruned = verify(query, true);
+                auto unpruned = verify(query, false);
+                BOOST_CHECK_MESSAGE(pruned["result"] == unpruned["result"], query);
+                BOOST_CHECK_EQUAL(pruned["mode"], unpruned["mode"]);
+            }
+        }
+    }
+    // The only witness leaves Router2 on the backup interface, whose locations pruning must keep.
+    auto answer = verify("<.> [.#Router1] [^Router2#Router5]* [Router6#.] <.> 1 DUAL", true);
+    BOOST_CHECK_EQUAL(answer["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+}
+
+BOOST_AUTO_TEST_CASE(WildcardLabelFlowTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2", "Router3"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1", "Router3"},{"Router2"}};
+    auto network = Network::make_network(routers, links);
+    auto inf = [&network](size_t router, const std::string& name) { return network.get_router(router)->find_interface(name); };
+    using op_t = RoutingTable::op_t;
+    using action_t = RoutingTable::action_t;
+    // Label 10 becomes 40 on top after a swap and push on Router0 and a swap on Router1.
+    inf(0, "iRouter0")->table().add_rule(10, RoutingTable::forward_t({action_t(op_t::SWAP, 20), action_t(op_t::PUSH, 30)}, inf(0, "Router1"), 0));
+    inf(1, "Router0")->table().add_rule(30, action_t(op_t::SWAP, 40), inf(1, "Router2"));
+    // Label 11 is on top again after a push on Router0 and a pop on Router1.
+    inf(0, "iRouter0")->table().add_rule(11, action_t(op_t::PUSH, 31), inf(0, "Router1"));
+    inf(1, "Router0")->table().add_rule(31, action_t(op_t::POP), inf(1, "Router2"));
+    // Router2 forwards any label, so its entry must be expanded over the labels arriving there.
+    inf(2, "Router1")->table().add_rule(std::numeric_limits<RoutingTable::label_t>::max(), action_t(op_t::SWAP, 50), inf(2, "Router3"));
+    inf(3, "Router2")->table().add_rule(50, action_t(op_t::SWAP, 60), inf(3, "iRouter3"));
+
+    auto verify = [&](const std::string& query, bool prune) {
+        Builder builder(network);
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+        Verifier verifier;
+        verifier.set_print_trace();
+        verifier.set_pruning(prune);
+        return verifier.run_once(builder, builder._result[0], false);
+    };
+    for (const auto& path : {"<10> [.#Router0] .* [Router3#.] <.*>", "<11> [.#Router0] .* [Router3#.] <.*>"}) {
+        for (const auto& mode : {"OVER", "UNDER", "DUAL"}) {
+            auto query = std::string(path) + " 0 " + mode;
+            auto answer = verify(query, true);
+            BOOST_CHECK_MESSAGE(answer["result"].get<utils::outcome_t>() == utils::outcome_t::YES, query);
+            BOOST_CHECK_EQUAL(answer["result"], verify(query, false)["result"]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(IgnoreLabelTraceTest) {
+    std::vector<std::string> routers{"Router0", "Router1", "Router2", "Router3"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0", "Router2"},{"Router1", "Router3"},{"Router2"}};
+    auto network = Network::make_network(routers, links);
+    auto inf = [&network](size_t router, const std::string& name) { return network.get_router(router)->find_interface(name); };
+    using op_t = RoutingTable::op_t;
+    using action_t = RoutingTable::action_t;
+    inf(0, "iRouter0")->table().add_rule(10, RoutingTable::forward_t({action_t(op_t::SWAP, 20), action_t(op_t::PUSH, 30)}, inf(0, "Router1"), 0));
+    inf(1, "Router0")->table().add_rule(30, action_t(op_t::SWAP, 40), inf(1, "Router2"));
+    inf(2, "Router1")->table().add_rule(std::numeric_limits<RoutingTable::label_t>::max(), action_t(op_t::SWAP, 50), inf(2, "Router3"));
+    inf(3, "Router2")->table().add_rule(50, action_t(op_t::SWAP, 60), inf(3, "iRouter3"));
+
+    Builder builder(network);
+    std::istringstream qstream("<10> [.#Router0] .* [Router3#.] <.*> 0 OVER");
+    builder.do_parse(qstream);
+    Verifier verifier;
+    verifier.set_print_trace();
+    auto answer = verifier.run_once(builder, builder._result[0], false);
+
+    BOOST_CHECK_EQUAL(answer["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    const auto& trace = answer["trace"];
+    BOOST_REQUIRE_EQUAL(trace.size(), 9); // Five links and the four rules between them.
+    BOOST_CHECK_EQUAL(trace[0]["stack"], json::parse(R"(["10"])"));
+    BOOST_CHECK_EQUAL(trace[1]["pre"], "10");
+    BOOST_CHECK_EQUAL(trace[2]["stack"], json::parse(R"(["30", "20"])"));
+    BOOST_CHECK_EQUAL(trace[4]["stack"], json::parse(R"(["40", "20"])"));
+    // The step through the entry that ignores the label is concretized to that entry and its forward.
+    BOOST_CHECK_EQUAL(trace[5]["ingoing"], "Router1");
+    BOOST_CHECK_EQUAL(trace[5]["pre"], "null");
+    BOOST_CHECK_EQUAL(trace[5]["rule"]["via"], "Router3");
+    BOOST_CHECK_EQUAL(trace[5]["rule"]["ops"], json::parse(R"([{"swap": "50"}])"));
+    BOOST_CHECK_EQUAL(trace[6]["from_router"], "Router2");
+    BOOST_CHECK_EQUAL(trace[6]["stack"], json::parse(R"(["50", "20"])"));
+    BOOST_CHECK_EQUAL(trace[8]["stack"], json::parse(R"(["60", "20"])"));
+}
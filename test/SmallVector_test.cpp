@@ -0,0 +1,114 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   SmallVector_test.cpp
+ */
+
+#define BOOST_TEST_MODULE SmallVectorTest
+
+#include <boost/test/unit_test.hpp>
+#include <aalwines/utils/small_vector.h>
+
+using namespace utils;
+
+using vector_t = small_vector<size_t, 2>;
+
+static std::vector<size_t> to_vector(const vector_t& v) {
+    return std::vector<size_t>(v.begin(), v.end());
+}
+
+BOOST_AUTO_TEST_CASE(InlineToHeap) {
+    vector_t v;
+    BOOST_CHECK_EQUAL(v.capacity(), 2);
+    v.push_back(1);
+    v.push_back(2);
+    auto inline_data = v.data();
+    BOOST_CHECK_EQUAL(v.capacity(), 2);
+    v.push_back(3);
+    BOOST_CHECK_NE(v.data(), inline_data);
+    BOOST_CHECK_EQUAL(v.capacity(), 4);
+    for (size_t i = 4; i <= 20; ++i) {
+        v.emplace_back(i);
+    }
+    BOOST_CHECK_EQUAL(v.size(), 20);
+    for (size_t i = 0; i < v.size(); ++i) {
+        BOOST_CHECK_EQUAL(v[i], i + 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(AliasingPush) {
+    vector_t v{7, 8};
+    v.push_back(v[0]); // Grows from inline to heap storage.
+    BOOST_CHECK(to_vector(v) == (std::vector<size_t>{7, 8, 7}));
+    v.push_back(v[1]);
+    v.push_back(v[3]); // Grows from heap to heap storage.
+    BOOST_CHECK(to_vector(v) == (std::vector<size_t>{7, 8, 7, 8, 8}));
+    v.emplace_back(v.back());
+    BOOST_CHECK_EQUAL(v.size(), 6);
+    BOOST_CHECK_EQUAL(v.back(), 8);
+}
+
+BOOST_AUTO_TEST_CASE(CopyAndMove) {
+    vector_t small{1};
+    vector_t large{1, 2, 3, 4, 5};
+
+    vector_t small_copy(small);
+    vector_t large_copy(large);
+    BOOST_CHECK(small_copy == small);
+    BOOST_CHECK(large_copy == large);
+    BOOST_CHECK_NE(large_copy.data(), large.data());
+    large_copy[0] = 42;
+    BOOST_CHECK_EQUAL(large[0], 1);
+
+    large_copy = small;
+    BOOST_CHECK(large_copy == small);
+    small_copy = large;
+    BOOST_CHECK(small_copy == large);
+    small_copy = small_copy;
+    BOOST_CHECK(small_copy == large);
+
+    auto large_data = large.data();
+    vector_t large_moved(std::move(large));
+    BOOST_CHECK_EQUAL(large_moved.data(), large_data); // Heap storage is taken over.
+    BOOST_CHECK(to_vector(large_moved) == (std::vector<size_t>{1, 2, 3, 4, 5}));
+    BOOST_CHECK(large.empty());
+    BOOST_CHECK_EQUAL(large.capacity(), 2);
+    large.push_back(6); // Still usable after the move.
+    BOOST_CHECK(to_vector(large) == (std::vector<size_t>{6}));
+
+    vector_t small_moved;
+    small_moved = std::move(small);
+    BOOST_CHECK(to_vector(small_moved) == (std::vector<size_t>{1}));
+    BOOST_CHECK(small.empty());
+    large_moved = std::move(small_moved);
+    BOOST_CHECK(to_vector(large_moved) == (std::vector<size_t>{1}));
+    BOOST_CHECK_EQUAL(large_moved.capacity(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(Insert) {
+    vector_t v;
+    auto it = v.insert(v.end(), 3);
+    BOOST_CHECK_EQUAL(*it, 3);
+    it = v.insert(v.begin(), 1);
+    BOOST_CHECK_EQUAL(*it, 1);
+    it = v.insert(v.begin() + 1, 2); // Grows from inline to heap storage.
+    BOOST_CHECK_EQUAL(*it, 2);
+    BOOST_CHECK(to_vector(v) == (std::vector<size_t>{1, 2, 3}));
+    v.insert(v.begin(), v[2]); // Inserts a copy of an element of the vector itself.
+    BOOST_CHECK(to_vector(v) == (std::vector<size_t>{3, 1, 2, 3}));
+    v.insert(v.begin() + 2, v.back()); // And again while growing.
+    BOOST_CHECK(to_vector(v) == (std::vector<size_t>{3, 1, 3, 2, 3}));
+}